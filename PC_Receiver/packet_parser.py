@@ -19,6 +19,10 @@ class PacketHeader:
 class RouteDataPacket:
     via: int
 
+@dataclass
+class DataPacket:
+    number: int
+
 @dataclass
 class TestData:
     sequenceNumber: int
@@ -52,6 +56,15 @@ def parse_route_data_packet(data: bytes, offset=0) -> tuple[RouteDataPacket, int
     return RouteDataPacket(via), offset + size
 
 
+def parse_data_packet(data: bytes, offset=0) -> tuple[DataPacket, int]:
+    fmt = "<H"  # uint16_t 源节点的序号
+    size = struct.calcsize(fmt)
+    if len(data) < offset + size:
+        raise ValueError("数据不足以解包 DataPacket")
+    (number,) = struct.unpack_from(fmt, data, offset)
+    return DataPacket(number), offset + size
+
+
 def parse_test_data(data: bytes, offset: int, payload_len: int) -> tuple[TestData, int]:
     header_fmt = "<IB"
     header_size = struct.calcsize(header_fmt)  # 5字节
@@ -82,16 +95,18 @@ def parse_packet(data: bytes) -> dict:
     offset = 0
     header, offset = parse_packet_header(data, offset)
     route_data, offset = parse_route_data_packet(data, offset)
+    data_packet, offset = parse_data_packet(data, offset)
 
     result = {
         "header": header,
         "via": route_data.via,  # 新增这一行
+        "number": data_packet.number,
         "type": None,
         "payload": None
     }
 
     total_packet_len = header.packetSize  # 整包长度（包含头）
-    header_len = offset  # 已经读取的头部长度，6字节
+    header_len = offset  # 已经读取的头部长度，10字节
     payload_len = total_packet_len - header_len
 
     if len(data) < total_packet_len:
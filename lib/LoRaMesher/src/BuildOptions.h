@@ -57,7 +57,12 @@ extern const char* LM_VERSION;
 #define LM_CODING_RATE 7U
 #define LM_PREAMBLE_LENGTH 8U
 #define LM_POWER 22
+// Maximum percentage of each hour that the node can be transmitting (e.g. 1 or 10 depending on the region)
 #define LM_DUTY_CYCLE 100
+// Percentage of the duty cycle budget reserved for control packets (hello, ACK and lost packets)
+#define LM_CONTROL_AIRTIME_RESERVE 20
+// The one hour duty cycle window is divided in one minute buckets
+#define LM_AIRTIME_WINDOW_BUCKETS 60
 
 //Syncronization Word that identifies the mesh network
 #define LM_SYNC_WORD 0x12
@@ -65,13 +70,35 @@ extern const char* LM_VERSION;
 // Comment this line if you want to remove the crc for each packet
 #define LM_ADDCRC_PAYLOAD
 
-// Routing table max size
+// Default routing table capacity. The routes are reserved in a pool when the configuration is initialized
 #define RTMAXSIZE 256
 
+// Number of received packets that can be waiting to be processed. Rounded up to a power of two.
+// When it is full, new received packets are dropped and counted as overflows.
+#define LM_RECEIVED_QUEUE_SIZE 32
+
+// Number of packets that can be waiting to be sent. When it is full, new packets are dropped.
+#define LM_SEND_QUEUE_SIZE 64
+
+// Number of blocks of each memory pool, used when LM_USE_MEMORY_POOL is defined.
+// Packet blocks have LM_MAX_PACKET_SIZE bytes, bigger packets and allocations when a pool is empty use the heap.
+#define LM_PACKET_POOL_SIZE 48
+#define LM_QUEUE_PACKET_POOL_SIZE 64
+#define LM_LIST_NODE_POOL_SIZE 96
+
+// Maximum time in ms that a small data packet waits to be sent together with other data packets to the same next hop.
+// The packets only wait while another packet is on air, when nothing else is queued they are sent at once.
+// 0 disables the aggregation.
+#define LM_AGGREGATION_HOLD_MS 500
+// Number of next hops that can be aggregating at the same time
+#define LM_AGGREGATION_BUFFERS 4
+// Maximum data packets inside an aggregated packet
+#define LM_AGGREGATION_MAX_PACKETS 8
+
 //MAX packet size per packet in bytes. It could be changed between 13 and 255 bytes. Recommended 100 or less bytes.
 //If exceed it will be automatically separated through multiple packets
 //In bytes (226 bytes [UE max allowed with SF7 and 125khz])
-//MAX payload size for hello packets = LM_MAX_PACKET_SIZE - 7 bytes of header
+//MAX payload size for hello packets = LM_MAX_PACKET_SIZE - 17 bytes of header
 //MAX payload size for data packets = LM_MAX_PACKET_SIZE - 7 bytes of header - 2 bytes of via
 //MAX payload size for reliable and large packets = LM_MAX_PACKET_SIZE - 7 bytes of header - 2 bytes of via - 3 of control packet
 #define LM_MAX_PACKET_SIZE 100
@@ -85,6 +112,9 @@ extern const char* LM_VERSION;
 #define LOST_P          0b00100010
 #define SYNC_P          0b01000010
 #define ROUTE_TABLE_P   0b00000110
+#define AGG_DATA_P      0b10000010
+#define SACK_P          0b00101010
+#define FLOOD_P         0b10000000
 
 // Packet configuration
 typedef enum {
@@ -101,12 +131,102 @@ typedef enum {
 #define ROUTING_TABLE_UPDATE_DELAY 2 // 路由表更新间隔（秒）
 #define HELLO_PACKETS_DELAY 5 // Hello包生成间隔
 #define DEFAULT_TIMEOUT HELLO_PACKETS_DELAY*1
+// Hellos are scheduled with a Trickle timer. The interval starts at LM_TRICKLE_IMIN_MS and doubles
+// LM_TRICKLE_IMAX_DOUBLINGS times at most while the routing table does not change.
+#define LM_TRICKLE_IMIN_MS 2000
+#define LM_TRICKLE_IMAX_DOUBLINGS 5
+// Maximum hello interval, the largest one the hellos can advertise (255 s)
+#define LM_TRICKLE_IMAX_MS (UINT8_MAX * 1000UL)
+// Consistent hellos heard inside an interval that suppress our hello. 0 disables the suppression
+#define LM_TRICKLE_K 0
+// Route timeout in hello intervals of the next hop. The next hello can arrive 2.5 intervals later,
+// 6.5 if one hello is suppressed, the rest allows losing a hello.
+#define LM_ROUTE_TIMEOUT_INTERVALS 8
+// Hellos only carry the routes that changed since the previous hello. Every LM_FULL_HELLO_EVERY hellos
+// the whole routing table is sent, even if no neighbor asked for it.
+#define LM_FULL_HELLO_EVERY 12
+// Removed routes remembered until the next hello. If more routes are removed, the next hello is a full one.
+#define LM_MAX_REMOVED_ROUTES 16
+// Metric advertised for a removed route
+#define LM_UNREACHABLE_METRIC 0xFF
+// The removed routes are advertised without waiting for the next hello, with a triggered hello. Minimum time in ms
+// between a triggered hello and the previous hello
+#define LM_TRIGGERED_HELLO_MIN_MS 1000
+// Time in ms after removing a route in which the routes to the same address with a greater metric are ignored,
+// so the neighbors that did not receive the removal yet can not bring it back
+#define LM_ROUTE_HOLDDOWN_MS 6000
+// Best CLIENT or GATEWAY nodes the data of the different sources is balanced across
+#define LM_UPLINK_CANDIDATES 4
+// Packets waiting to be uploaded by a CLIENT or GATEWAY node advertised as the maximum uplink load
+#define LM_UPLINK_QUEUE_FULL 32
+// Link quality aware routing. The cost of a route is the sum of the expected transmissions (ETX) of its links,
+// in 1/LM_ETX_SCALE units. The ETX of a link is estimated from the ratio of hellos received from the neighbor,
+// assuming the same losses in both directions, plus a penalty for each dB of SNR under LM_ETX_SNR_THRESHOLD.
+#define LM_ETX_SCALE 8
+// Weight of each hello in the reception ratio, 1 / 2^LM_ETX_RATIO_SHIFT
+#define LM_ETX_RATIO_SHIFT 3
+#define LM_ETX_SNR_THRESHOLD -5
+#define LM_ETX_SNR_PENALTY 2
+// Maximum cost of a single link
+#define LM_ETX_MAX_LINK_COST 64
+// A route through another next hop needs to be cheaper by this cost to replace the actual one. Smaller changes
+// of the cost of a route are not advertised until the next full hello.
+#define LM_ETX_HYSTERESIS 4
+// Alternative next hops remembered for each route, ranked by their cost
+#define LM_BACKUP_VIAS 2
+// A next hop is stale when it has not sent a hello in this number of its hello intervals, the next
+// hello can arrive 2.5 intervals later. The routes through a stale next hop use the best backup one.
+#define LM_VIA_STALE_INTERVALS 3
+// Timeouts of reliable payloads through a next hop before the route uses the best backup one
+#define LM_VIA_MAX_FAILURES 2
+// Neighbors whose link state is kept, independent of the routing table. When it is full, the neighbor
+// that expires first is replaced. The routes through it are kept until their own timeout
+#define LM_MAX_NEIGHBORS 32
+// Route replaced when the routing table is full and a new route arrives
+typedef enum {
+    LM_EVICT_NON_NEIGHBOR_FIRST, // The worst route that is not a neighbor, then the worst neighbor
+    LM_EVICT_WORST_METRIC, // The worst route
+    LM_EVICT_LEAST_RECENTLY_USED // The route that has not been used to send for the longest time
+} route_eviction_e;
+#define LM_ROUTE_EVICTION LM_EVICT_NON_NEIGHBOR_FIRST
+// The routes used to send in the last seconds are never replaced
+#define LM_ROUTE_ACTIVE_S 60
+// Resolution in ms of the round-trip times stored in each route, up to 65535 units
+#define LM_RTT_UNIT_MS 2
 #define MIN_TIMEOUT 20
 
 //Maximum times that a sequence of packets reach the timeout
 #define MAX_TIMEOUTS 10
 #define MAX_RESEND_PACKET 3
 #define MAX_TRY_BEFORE_SEND 5
+// Packets of a reliable payload that can be sent without being acknowledged. The receiver keeps the packets
+// received out of order inside the same window. 1 waits for the ACK of each packet before sending the next one.
+#define LM_RELIABLE_WINDOW_SIZE 4
+// Packets inside the send queue of a node from which it signals the senders of reliable payloads to reduce their window.
+// The ACKs carry the greatest send queue depth of the nodes they go through.
+#define LM_CONGESTION_QUEUE_THRESHOLD 8
+
+// Duplicate cache of the forwarded data packets. A packet is remembered between one and two generations.
+// Packets forwarded in each generation
+#define LM_DUPLICATE_CACHE_SIZE 64
+// False positive rate of the duplicate cache when a generation is full
+#define LM_DUPLICATE_CACHE_FP_RATE 0.01
+// Time in ms of each generation. 0 disables the duplicate cache
+#define LM_DUPLICATE_CACHE_MS 2000
+
+// Flooding of the packets sent to the whole network
+// Maximum random delay in ms before relaying a flooded packet
+#define LM_FLOOD_MAX_DELAY_MS 1000
+// Copies heard before relaying a flooded packet that suppress the relay. 0 disables the suppression
+#define LM_FLOOD_REDUNDANCY 3
+// Maximum hops of a flooded packet
+#define LM_FLOOD_MAX_HOPS 8
+// Origins whose last sequence numbers are remembered to detect duplicates
+#define LM_FLOOD_ORIGINS 16
+// Flooded packets that can be waiting to be relayed
+#define LM_FLOOD_PENDING 8
+// Maximum backoff exponent of the channel access, the backoff is random between 1 and 2^exponent max time on air slots
+#define LM_CSMA_MAX_BACKOFF_EXPONENT 5
 
 //Role Types
 #define ROLE_DEFAULT  0b00000000
@@ -114,6 +234,11 @@ typedef enum {
 #define ROLE_GATEWAY  0b00000010
 #define ROLE_RELAY    0b00000100
 #define ROLE_TERMINAL 0b00001000
+// The upper nibble of the role advertised in the hellos is the uplink load of the CLIENT and GATEWAY nodes, from 0 to 15
+#define ROLE_MASK 0b00001111
+#define ROLE_BITS 4
+#define LM_UPLINK_LOAD_SHIFT 4
+#define LM_UPLINK_LOAD_MAX 15
 
 //WiFi Para
 #define WIFINAME "ForestFrame-Hotspot"
@@ -125,5 +250,7 @@ typedef enum {
 //Switches
 #define LM_ENABLE_WIFI_SERVICE
 #define LM_ENABLE_TESTDATA_SERVICE
+// Comment this line to allocate packets, queue packets and list nodes directly from the heap
+#define LM_USE_MEMORY_POOL
 
 #endif
\ No newline at end of file
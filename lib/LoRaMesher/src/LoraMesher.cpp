@@ -92,12 +92,22 @@ LoraMesher::~LoraMesher()
     // 停止日志管理器
     LogManager::getInstance().stop();
 
-    ToSendPackets->Clear();
+    QueuePacket<Packet<uint8_t>> *pendingTx;
+    while ((pendingTx = ToSendPackets->Pop()) != nullptr)
+        PacketQueueService::deleteQueuePacketAndPacket(pendingTx);
     delete ToSendPackets;
-    ReceivedPackets->Clear();
+    while (DeferredPackets->getLength() > 0)
+        PacketQueueService::deleteQueuePacketAndPacket(DeferredPackets->Pop());
+    delete DeferredPackets;
+    AggregationService::clear();
+    FloodService::clear();
+    QueuePacket<Packet<uint8_t>> *pendingRx;
+    while ((pendingRx = ReceivedPackets->Pop()) != nullptr)
+        PacketQueueService::deleteQueuePacketAndPacket(pendingRx);
     delete ReceivedPackets;
     ReceivedAppPackets->Clear();
     delete ReceivedAppPackets;
+    delete duplicateFilter;
 
     clearDioActions();
     radio->reset();
@@ -131,6 +141,22 @@ void LoraMesher::initConfiguration()
     SAFE_ESP_LOGV(LM_TAG, "Initializing Configuration");
 
     PacketFactory::setMaxPacketSize(loraMesherConfig->max_packet_size);
+
+    AirtimeService::init(loraMesherConfig->dutyCycle, loraMesherConfig->controlAirtimeReserve);
+
+    AggregationService::init(loraMesherConfig->aggregationHoldTime);
+
+    TrickleService::init(loraMesherConfig->helloIntervalMin, loraMesherConfig->helloIntervalDoublings, loraMesherConfig->helloRedundancy);
+
+    FloodService::init(loraMesherConfig->floodMaxDelay, loraMesherConfig->floodRedundancy);
+
+    RoutingTableService::init(loraMesherConfig->linkQualityRouting, loraMesherConfig->routeHysteresis,
+                              loraMesherConfig->routingTableCapacity, loraMesherConfig->routeEviction);
+
+    delete duplicateFilter;
+    duplicateFilter = nullptr;
+    if (loraMesherConfig->duplicateCacheTime > 0)
+        duplicateFilter = new LM_DuplicateFilter(loraMesherConfig->duplicateCacheSize, loraMesherConfig->duplicateCacheFalsePositiveRate, loraMesherConfig->duplicateCacheTime);
 }
 
 void LoraMesher::initializeLoRa()
@@ -323,6 +349,12 @@ void LoraMesher::initializeSchedulers()
     // 现在可以使用安全的日志输出
     SAFE_ESP_LOGI("initializeSchedulers", "Starting scheduler initialization with safe logging.");
 
+    txDoneSemaphore = xSemaphoreCreateBinary();
+    if (txDoneSemaphore == NULL)
+    {
+        SAFE_ESP_LOGE("initializeSchedulers", "Transmit done semaphore not created");
+    }
+
     int res = xTaskCreate(
         [](void *o)
         { static_cast<LoraMesher *>(o)->receivingRoutine(); },
@@ -359,6 +391,7 @@ void LoraMesher::initializeSchedulers()
     {
         SAFE_ESP_LOGE("initializeSchedulers", "Process Task creation gave error: %d!", res);
     }
+    TrickleService::setHelloTask(Hello_TaskHandle);
     res = xTaskCreate(
         [](void *o)
         { static_cast<LoraMesher *>(o)->processPackets(); },
@@ -447,6 +480,19 @@ void LoraMesher::onReceive(void)
         portYIELD_FROM_ISR();
 }
 
+#if defined(ESP8266) || defined(ESP32)
+ICACHE_RAM_ATTR
+#endif
+void LoraMesher::onTransmitDone(void)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    xSemaphoreGiveFromISR(LoraMesher::getInstance().txDoneSemaphore, &xHigherPriorityTaskWoken);
+
+    if (xHigherPriorityTaskWoken == pdTRUE)
+        portYIELD_FROM_ISR();
+}
+
 void LoraMesher::receivingRoutine()
 {
     SAFE_ESP_LOGV(LM_TAG, "Receiving routine started");
@@ -470,8 +516,6 @@ void LoraMesher::receivingRoutine()
             SAFE_ESP_LOGV(LM_TAG, "Stack space unused after entering the task: %d.", uxTaskGetStackHighWaterMark(NULL));
             SAFE_ESP_LOGV(LM_TAG, "Free heap: %d.", getFreeHeap());
 
-            hasReceivedMessage = true;
-
             packetSize = radio->getPacketLength();
             if (packetSize == 0)
                 SAFE_ESP_LOGW(LM_TAG, "Empty packet received.");
@@ -515,8 +559,12 @@ void LoraMesher::receivingRoutine()
                     // Create a Packet Queue element containing the Packet
                     QueuePacket<Packet<uint8_t>> *pq = PacketQueueService::createQueuePacket(rx, 0, 0, rssi, snr);
 
-                    // Add the Packet Queue element created into the ReceivedPackets List
-                    ReceivedPackets->Append(pq);
+                    // Add the Packet Queue element created into the ReceivedPackets ring
+                    if (!ReceivedPackets->Push(pq))
+                    {
+                        ESP_LOGW(LM_TAG, "Received packets queue full, packet dropped!");
+                        PacketQueueService::deleteQueuePacketAndPacket(pq);
+                    }
 
                     // Notify that a packet needs to be process
                     TWres = xTaskNotifyFromISR(
@@ -541,28 +589,46 @@ uint16_t LoraMesher::getLocalAddress()
  *  Region Packet Service
  **/
 
-void LoraMesher::waitBeforeSend(uint8_t repeatedDetectPreambles)
+bool LoraMesher::waitChannelFree()
 {
-    // TODO: Why did I set this if?
-    if (repeatedDetectPreambles > RoutingTableService::routingTableSize())
-        return;
+    uint32_t slot = getMaxPropagationTime() > 0 ? getMaxPropagationTime() : 1;
 
-    hasReceivedMessage = false;
+    // Initial random delay inside one slot, nodes forwarding the same packet do not scan at the same time
+    uint32_t initialDelay = random(0, slot);
+    vTaskDelay(initialDelay / portTICK_PERIOD_MS);
 
-    // Random delay, to avoid some collisions.
-    uint32_t randomDelay = getPropagationTimeWithRandom(repeatedDetectPreambles);
+    for (uint8_t attempt = 0; attempt < loraMesherConfig->maxChannelAccessAttempts; attempt++)
+    {
+        setDioActionsForScanChannel();
 
-    SAFE_ESP_LOGV(LM_TAG, "RandomDelay %d ms", (int)randomDelay);
+        int res = radio->scanChannel();
 
-    // Set a random delay, to avoid some collisions.
-    vTaskDelay(randomDelay / portTICK_PERIOD_MS);
+        if (res == RADIOLIB_CHANNEL_FREE)
+            return true;
 
-    if (hasReceivedMessage)
-    {
+        if (res != RADIOLIB_LORA_DETECTED && res != RADIOLIB_PREAMBLE_DETECTED)
+        {
+            // Channel activity detection not available, send as before
+            SAFE_ESP_LOGW(LM_TAG, "Channel scan gave error: %d", res);
+            return true;
+        }
+
+        incBusyChannel();
+
+        // Keep receiving the packet that is on air while waiting
         startReceiving();
-        SAFE_ESP_LOGV(LM_TAG, "Preamble detected while waiting %d", repeatedDetectPreambles);
-        waitBeforeSend(repeatedDetectPreambles + 1);
+
+        uint8_t exponent = attempt + 1 < LM_CSMA_MAX_BACKOFF_EXPONENT ? attempt + 1 : LM_CSMA_MAX_BACKOFF_EXPONENT;
+        uint32_t backoff = random(1, (1 << exponent) + 1) * slot;
+
+        SAFE_ESP_LOGV(LM_TAG, "Channel busy, attempt %d, backoff %d ms", attempt + 1, (int)backoff);
+
+        incBackoffTime(backoff);
+        vTaskDelay(backoff / portTICK_PERIOD_MS);
     }
+
+    incChannelAccessFailure();
+    return false;
 }
 
 uint32_t LoraMesher::getMaxPropagationTime()
@@ -570,29 +636,213 @@ uint32_t LoraMesher::getMaxPropagationTime()
     return maxTimeOnAir;
 }
 
-bool LoraMesher::sendPacket(Packet<uint8_t> *p)
+bool LoraMesher::startSendPacket(Packet<uint8_t> *p)
 {
-    waitBeforeSend(1);
+    if (!waitChannelFree())
+    {
+        SAFE_ESP_LOGW(LM_TAG, "Channel busy, packet not sent");
+        return false;
+    }
 
     clearDioActions();
 
     // Print the packet to be sent
     printHeaderPacket(p, "send");
 
-    // Blocking transmit, it is necessary due to deleting the packet after sending it.
-    int resT = radio->transmit(reinterpret_cast<uint8_t *>(p), p->packetSize);
+    // Remove a transmit done given after a timeout
+    xSemaphoreTake(txDoneSemaphore, 0);
+
+    radio->setDioActionForTransmitting(onTransmitDone);
+
+    // Non blocking transmit, the packet needs to be kept until waitPacketSent returns
+    int resT = radio->startTransmit(reinterpret_cast<uint8_t *>(p), p->packetSize);
+
+    if (resT != RADIOLIB_ERR_NONE)
+    {
+        SAFE_ESP_LOGE(LM_TAG, "Start transmit gave error: %d", resT);
+        startReceiving();
+        return false;
+    }
+    return true;
+}
+
+bool LoraMesher::waitPacketSent(Packet<uint8_t> *p)
+{
+    // Same timeout as the blocking transmit, 150% of the time on air
+    uint32_t timeOnAir = radio->getTimeOnAir(p->packetSize) / 1000;
+    TickType_t timeout = (timeOnAir * 3 / 2 + 10) / portTICK_PERIOD_MS + 1;
+
+    bool hasSend = xSemaphoreTake(txDoneSemaphore, timeout) == pdTRUE;
+
+    int resT = radio->finishTransmit();
 
     // Start receiving again after sending a packet
     startReceiving();
 
+    if (!hasSend)
+    {
+        SAFE_ESP_LOGE(LM_TAG, "Transmit timeout after %d ms", (int)(timeOnAir * 3 / 2 + 10));
+        return false;
+    }
+
     if (resT != RADIOLIB_ERR_NONE)
     {
-        SAFE_ESP_LOGE(LM_TAG, "Transmit gave error: %d", resT);
+        SAFE_ESP_LOGE(LM_TAG, "Finish transmit gave error: %d", resT);
         return false;
     }
     return true;
 }
 
+QueuePacket<Packet<uint8_t>> *LoraMesher::getNextPacketToSend()
+{
+    ToSendPackets->setInUse();
+
+    SAFE_ESP_LOGI("sendPackets", "Size of Send Packets Queue: %d.", ToSendPackets->getLength());
+
+    QueuePacket<Packet<uint8_t>> *tx = ToSendPackets->Pop();
+
+    ToSendPackets->releaseInUse();
+
+    if (tx == nullptr)
+        return nullptr;
+
+    SAFE_ESP_LOGI("sendPackets", "Popped packet with type %d and priority %d and number %d",
+                  tx->packet->type, tx->priority, tx->number);
+
+    // If the packet has a data packet and its destination is not broadcast add the via to the packet and forward the packet
+    if (PacketService::isDataPacket(tx->packet->type) && tx->packet->dst != ADDR_BROADCAST) // 中转的业务数据走这个判断
+    {
+        uint16_t nextHop = RoutingTableService::getNextHop(tx->packet->dst);
+
+        // Next hop not found
+        if (nextHop == 0)
+        {
+            SAFE_ESP_LOGE(LM_TAG, "NextHop Not found from %X, destination %X.", tx->packet->src, tx->packet->dst);
+            PacketQueueService::deleteQueuePacketAndPacket(tx);
+            incDestinyUnreachable();
+            return nullptr;
+        }
+
+        (reinterpret_cast<DataPacket *>(tx->packet))->via = nextHop;
+        SAFE_ESP_LOGD("sendPackets", "Send data to %X, via %X.", tx->packet->dst, (reinterpret_cast<DataPacket *>(tx->packet))->via);
+    }
+    else if (PacketService::isDataPacket(tx->packet->type) && tx->packet->dst == ADDR_BROADCAST) // 数据源的走这个判断
+    {
+        tx->packet->dst = RoutingTableService::decideHowToSendData(tx->packet->src);
+        switch (tx->packet->dst)
+        {
+        case ADDR_WIFI:
+        {
+            (reinterpret_cast<DataPacket *>(tx->packet))->via = ADDR_WIFI;
+            printHeaderPacket(tx->packet, "send");
+            SAFE_ESP_LOGD("sendPackets", "Sending data to %X via WiFi with %d bytes.", tx->packet->dst, tx->packet->packetSize);
+            WiFiTransmitter::getInstance().sendPacketToServer(reinterpret_cast<uint8_t *>(tx->packet), tx->packet->packetSize);
+            PacketQueueService::deleteQueuePacketAndPacket(tx);
+            return nullptr;
+        }
+        case ADDR_4G:
+        {
+            (reinterpret_cast<DataPacket *>(tx->packet))->via = ADDR_4G;
+            // TODO: Implement 4G sending
+        }
+        case NO_DESTNATION:
+        {
+            SAFE_ESP_LOGW("sendPackets", "No destination found, not sending!");
+            PacketQueueService::deleteQueuePacketAndPacket(tx);
+            incDestinyUnreachable();
+            return nullptr;
+        }
+        default:
+        {
+            uint16_t nextHop = RoutingTableService::getNextHop(tx->packet->dst);
+            // Next hop not found
+            if (nextHop == 0)
+            {
+                SAFE_ESP_LOGE(LM_TAG, "NextHop Not found from %X, destination %X!", tx->packet->src, tx->packet->dst);
+                PacketQueueService::deleteQueuePacketAndPacket(tx);
+                incDestinyUnreachable();
+                return nullptr;
+            }
+
+            (reinterpret_cast<DataPacket *>(tx->packet))->via = nextHop;
+            SAFE_ESP_LOGD("sendPackets", "Send data to %X, via %X.", tx->packet->dst, (reinterpret_cast<DataPacket *>(tx->packet))->via);
+        }
+        }
+    }
+
+    return tx;
+}
+
+QueuePacket<Packet<uint8_t>> *LoraMesher::getNextFrameToSend(bool flush)
+{
+    QueuePacket<Packet<uint8_t>> *tx = AggregationService::popReady();
+    if (tx != nullptr)
+        return tx;
+
+    // Take all the queued data packets that can be aggregated until one needs to be sent
+    while (ToSendPackets->getLength() > 0)
+    {
+        tx = getNextPacketToSend();
+        if (tx == nullptr)
+            continue;
+
+        if (!AggregationService::add(tx))
+            return tx;
+
+        tx = AggregationService::popReady();
+        if (tx != nullptr)
+            return tx;
+    }
+
+    // Nothing else is queued, do not wait for packets that may not come
+    if (flush)
+        return AggregationService::popPending();
+
+    return nullptr;
+}
+
+bool LoraMesher::usesControlAirtime(uint8_t type)
+{
+    return PacketService::isHelloPacket(type) || PacketService::isAckPacket(type) || PacketService::isLostPacket(type);
+}
+
+void LoraMesher::releaseDeferredPackets()
+{
+    uint32_t releasedAirtime = 0;
+    size_t releasedNum = 0;
+
+    // Release the oldest packets while the budget left covers all of them, the others keep waiting here
+    while (DeferredPackets->getLength() > 0)
+    {
+        QueuePacket<Packet<uint8_t>> *qp = DeferredPackets->First();
+        uint32_t timeOnAir = radio->getTimeOnAir(qp->packet->packetSize) / 1000;
+
+        if (!AirtimeService::canSend(releasedAirtime + timeOnAir, false))
+            break;
+
+        // They are not deleted while the send queue is full, they are released when it has space
+        if (ToSendPackets->getLength() >= ToSendPackets->getCapacity() || !PacketQueueService::addOrdered(ToSendPackets, qp))
+            break;
+
+        DeferredPackets->Pop();
+        releasedAirtime += timeOnAir;
+        releasedNum++;
+    }
+
+    if (releasedNum > 0)
+        SAFE_ESP_LOGI("sendPackets", "Duty cycle budget released, %d deferred packets moved to the send queue, %d waiting", releasedNum, DeferredPackets->getLength());
+}
+
+void LoraMesher::releaseFloodPackets()
+{
+    QueuePacket<Packet<uint8_t>> *qp;
+    while ((qp = FloodService::popReady()) != nullptr)
+    {
+        if (!PacketQueueService::addOrdered(ToSendPackets, qp))
+            PacketQueueService::deleteQueuePacketAndPacket(qp);
+    }
+}
+
 void LoraMesher::sendPackets()
 {
     SAFE_ESP_LOGV("sendPackets", "Send routine started.");
@@ -607,99 +857,85 @@ void LoraMesher::sendPackets()
 #else
     srand(getLocalAddress());
 #endif
-    const uint8_t dutyCycleEvery = (100 - LM_DUTY_CYCLE) / portTICK_PERIOD_MS;
+    QueuePacket<Packet<uint8_t>> *staged = nullptr;
 
     for (;;)
     {
-        /* Wait for the notification of new packet has to be sent and enter blocking */
-        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+        /* Wait for the notification of new packet has to be sent and enter blocking.
+         * If there are deferred packets, wake up when part of the duty cycle window is released */
+        TickType_t waitTicks = DeferredPackets->getLength() > 0 ? AirtimeService::getTimeUntilRelease() / portTICK_PERIOD_MS + 1 : portMAX_DELAY;
 
-        SAFE_ESP_LOGV("sendPackets", "Stack space unused after entering the task: %d.", uxTaskGetStackHighWaterMark(NULL));
-        SAFE_ESP_LOGV("sendPackets", "Free heap: %d.", getFreeHeap());
+        // Also wake up when a data packet has been held for the aggregation hold time
+        if (AggregationService::hasPending())
+        {
+            TickType_t aggregationTicks = AggregationService::getTimeUntilNextFlush() / portTICK_PERIOD_MS + 1;
+            if (aggregationTicks < waitTicks)
+                waitTicks = aggregationTicks;
+        }
 
-        while (ToSendPackets->getLength() > 0)
+        // Also wake up when a flooded packet needs to be relayed
+        if (FloodService::hasPending())
         {
+            TickType_t floodTicks = FloodService::getTimeUntilNextRelay() / portTICK_PERIOD_MS + 1;
+            if (floodTicks < waitTicks)
+                waitTicks = floodTicks;
+        }
+
+        ulTaskNotifyTake(pdFALSE, waitTicks);
 
-            ToSendPackets->setInUse();
+        releaseDeferredPackets();
 
-            SAFE_ESP_LOGI("sendPackets", "Size of Send Packets Queue: %d.", ToSendPackets->getLength());
+        releaseFloodPackets();
 
-            QueuePacket<Packet<uint8_t>> *tx = ToSendPackets->Pop();
+        SAFE_ESP_LOGV("sendPackets", "Stack space unused after entering the task: %d.", uxTaskGetStackHighWaterMark(NULL));
+        SAFE_ESP_LOGV("sendPackets", "Free heap: %d.", getFreeHeap());
 
-            SAFE_ESP_LOGI("sendPackets", "Popped packet with type %d and priority %d and number %d",
-                          tx->packet->type, tx->priority, tx->number);
+        while (staged != nullptr || AggregationService::hasPending() || ToSendPackets->getLength() > 0)
+        {
+            // Use the packet prepared while the previous one was on air
+            QueuePacket<Packet<uint8_t>> *tx = staged;
+            staged = nullptr;
 
-            ToSendPackets->releaseInUse();
+            if (tx == nullptr)
+                tx = getNextFrameToSend(true);
 
             if (tx)
             {
                 SAFE_ESP_LOGV("sendPackets", "Send num %d.", sendCounter);
 
-                // If the packet has a data packet and its destination is not broadcast add the via to the packet and forward the packet
-                if (PacketService::isDataPacket(tx->packet->type) && tx->packet->dst != ADDR_BROADCAST) // 中转的业务数据走这个判断
-                {
-                    uint16_t nextHop = RoutingTableService::getNextHop(tx->packet->dst);
-
-                    // Next hop not found
-                    if (nextHop == 0)
-                    {
-                        SAFE_ESP_LOGE(LM_TAG, "NextHop Not found from %X, destination %X.", tx->packet->src, tx->packet->dst);
-                        PacketQueueService::deleteQueuePacketAndPacket(tx);
-                        incDestinyUnreachable();
-                        continue;
-                    }
+                uint32_t timeOnAir = radio->getTimeOnAir(tx->packet->packetSize) / 1000;
 
-                    (reinterpret_cast<DataPacket *>(tx->packet))->via = nextHop;
-                    SAFE_ESP_LOGD("sendPackets", "Send data to %X, via %X.", tx->packet->dst, (reinterpret_cast<DataPacket *>(tx->packet))->via);
-                }
-                else if (PacketService::isDataPacket(tx->packet->type) && tx->packet->dst == ADDR_BROADCAST) // 数据源的走这个判断
+                // Data packets without budget wait, control packets can still be sent
+                if (!AirtimeService::canSend(timeOnAir, usesControlAirtime(tx->packet->type)))
                 {
-                    tx->packet->dst = RoutingTableService::decideHowToSendData();
-                    switch (tx->packet->dst)
-                    {
-                    case ADDR_WIFI:
-                    {
-                        (reinterpret_cast<DataPacket *>(tx->packet))->via = ADDR_WIFI;
-                        printHeaderPacket(tx->packet, "send");
-                        SAFE_ESP_LOGD("sendPackets", "Sending data to %X via WiFi with %d bytes.", tx->packet->dst, tx->packet->packetSize);
-                        WiFiTransmitter::getInstance().sendPacketToServer(reinterpret_cast<uint8_t *>(tx->packet), tx->packet->packetSize);
-                        PacketQueueService::deleteQueuePacketAndPacket(tx);
-                        continue;
-                    }
-                    case ADDR_4G:
-                    {
-                        (reinterpret_cast<DataPacket *>(tx->packet))->via = ADDR_4G;
-                        // TODO: Implement 4G sending
-                    }
-                    case NO_DESTNATION:
+                    if (DeferredPackets->getLength() >= LM_SEND_QUEUE_SIZE)
                     {
-                        SAFE_ESP_LOGW("sendPackets", "No destination found, not sending!");
+                        SAFE_ESP_LOGW("sendPackets", "Duty cycle exhausted and deferred queue full, deleting packet");
                         PacketQueueService::deleteQueuePacketAndPacket(tx);
-                        incDestinyUnreachable();
+                        incDutyCycleDropped();
                         continue;
                     }
-                    default:
-                    {
-                        uint16_t nextHop = RoutingTableService::getNextHop(tx->packet->dst);
-                        // Next hop not found
-                        if (nextHop == 0)
-                        {
-                            SAFE_ESP_LOGE(LM_TAG, "NextHop Not found from %X, destination %X!", tx->packet->src, tx->packet->dst);
-                            PacketQueueService::deleteQueuePacketAndPacket(tx);
-                            incDestinyUnreachable();
-                            continue;
-                        }
-
-                        (reinterpret_cast<DataPacket *>(tx->packet))->via = nextHop;
-                        SAFE_ESP_LOGD("sendPackets", "Send data to %X, via %X.", tx->packet->dst, (reinterpret_cast<DataPacket *>(tx->packet))->via);
-                    }
-                    }
+
+                    SAFE_ESP_LOGI("sendPackets", "Duty cycle exhausted, deferring packet with type %d", tx->packet->type);
+                    DeferredPackets->Append(tx);
+                    incDeferredPackets();
+                    continue;
                 }
 
                 recordState(LM_StateType::STATE_TYPE_SENT, tx->packet);
 
                 // Send packet
-                bool hasSend = sendPacket(tx->packet);
+                bool hasSend = startSendPacket(tx->packet);
+
+                if (hasSend)
+                {
+                    // Prepare the next packet while this one is on air
+                    staged = getNextFrameToSend(false);
+
+                    hasSend = waitPacketSent(tx->packet);
+
+                    AirtimeService::addAirtime(timeOnAir);
+                }
 
                 sendCounter++;
 
@@ -715,8 +951,17 @@ void LoraMesher::sendPackets()
                 // TODO: If the packet has not been send, add it to the queue and send it again
                 if (!hasSend && resendMessage < MAX_RESEND_PACKET)
                 {
+                    // Return the prepared packet to the queue, the packet not sent goes first
+                    if (staged != nullptr)
+                    {
+                        if (!PacketQueueService::addOrdered(ToSendPackets, staged))
+                            PacketQueueService::deleteQueuePacketAndPacket(staged);
+                        staged = nullptr;
+                    }
+
                     tx->priority = MAX_PRIORITY;
-                    PacketQueueService::addOrdered(ToSendPackets, tx);
+                    if (!PacketQueueService::addOrdered(ToSendPackets, tx))
+                        PacketQueueService::deleteQueuePacketAndPacket(tx);
 
                     resendMessage++;
                     continue;
@@ -724,15 +969,9 @@ void LoraMesher::sendPackets()
 
                 resendMessage = 0;
 
-                uint32_t timeOnAir = radio->getTimeOnAir(tx->packet->packetSize) / 1000;
-
-                TickType_t delayBetweenSend = timeOnAir * dutyCycleEvery;
-
-                SAFE_ESP_LOGI(LM_TAG, "TimeOnAir %d ms, next message in %d ms", (int)timeOnAir, (int)delayBetweenSend);
+                SAFE_ESP_LOGI(LM_TAG, "TimeOnAir %d ms, remaining data airtime %d ms", (int)timeOnAir, (int)AirtimeService::getRemainingAirtime(false));
 
                 PacketQueueService::deleteQueuePacketAndPacket(tx);
-
-                vTaskDelay(delayBetweenSend / portTICK_PERIOD_MS);
             }
         }
     }
@@ -748,19 +987,42 @@ void LoraMesher::sendHelloPacket()
 
     SAFE_ESP_LOGV(LM_TAG, "Max routing nodes per packet: %d", maxNodesPerPacket);
 
-    // Wait an initial 2 second
-    vTaskDelay(2000 / portTICK_PERIOD_MS);
-
     for (;;)
     {
+        uint32_t wait = TrickleService::getTimeUntilNextEvent();
+
+        // The removed routes are advertised without waiting for the next hello
+        uint32_t triggeredWait = RoutingTableService::getTimeUntilTriggeredHello();
+        bool triggered = triggeredWait == 0;
+
+        // Answer the full hello requests without waiting for the next hello
+        if (wait > 0 && !triggered && !RoutingTableService::isFullHelloRequested())
+        {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(triggeredWait < wait ? triggeredWait : wait));
+            continue;
+        }
+
+        // The hello is not suppressed if it contains changes
+        if (triggered)
+            incTriggeredHelloPackets();
+        else if (!TrickleService::process(RoutingTableService::hasHelloChanges()))
+            continue;
+
         SAFE_ESP_LOGV("sendHelloPacket", "Creating Routing Packet");
         SAFE_ESP_LOGV("sendHelloPacket", "Stack space unused after entering the task: %d", uxTaskGetStackHighWaterMark(NULL));
         SAFE_ESP_LOGV("sendHelloPacket", "Free heap: %d", getFreeHeap());
 
+        // The first hello and every LM_FULL_HELLO_EVERY hellos contain the whole routing table
+        bool full = sentHelloPacketsNum % LM_FULL_HELLO_EVERY == 0;
+
         incSentHelloPackets();
 
-        NetworkNode *nodes = RoutingTableService::getAllNetworkNodes();
-        size_t numOfNodes = RoutingTableService::routingTableSize();
+        size_t numOfNodes = 0;
+        uint16_t baseVersion, version, digest;
+        NetworkNode *nodes = RoutingTableService::getHelloNetworkNodes(full, numOfNodes, baseVersion, version, digest);
+
+        if (full)
+            incSentFullHelloPackets();
 
         size_t numPackets = (numOfNodes + maxNodesPerPacket - 1) / maxNodesPerPacket;
         numPackets = (numPackets == 0) ? 1 : numPackets;
@@ -778,20 +1040,42 @@ void LoraMesher::sendHelloPacket()
 
             // Create and send the packet
             RoutePacket *tx = PacketService::createRoutingPacket(
-                getLocalAddress(), &nodes[startIndex], nodesInThisPacket, RoleService::getRole());
+                getLocalAddress(), nodes == nullptr ? nullptr : &nodes[startIndex], nodesInThisPacket, getAdvertisedRole(),
+                full ? HELLO_FULL_F : 0, baseVersion, version, digest);
+
+            tx->fragment = i;
+            tx->fragments = numPackets;
+            tx->helloInterval = TrickleService::getIntervalSeconds();
+            tx->helloSequence = sentHelloPacketsNum;
+
+            incSentHelloBytes(tx->packetSize);
 
             setPackedForSend(reinterpret_cast<Packet<uint8_t> *>(tx), DEFAULT_PRIORITY + 2);
         }
 
         // Delete the nodes array
-        if (numOfNodes > 0)
+        if (nodes != nullptr)
             delete[] nodes;
-
-        // Wait for HELLO_PACKETS_DELAY seconds to send the next hello packet
-        vTaskDelay(HELLO_PACKETS_DELAY * 1000 / portTICK_PERIOD_MS);
     }
 }
 
+void LoraMesher::sendFullHelloRequest(uint16_t dst)
+{
+    SAFE_ESP_LOGI(LM_TAG, "Requesting full hello to %X", dst);
+
+    incFullHelloRequests();
+
+    RoutePacket *tx = PacketService::createRoutingPacket(
+        getLocalAddress(), nullptr, 0, getAdvertisedRole(), HELLO_REQUEST_FULL_F, 0, 0, 0);
+
+    tx->dst = dst;
+    tx->helloInterval = TrickleService::getIntervalSeconds();
+
+    incSentHelloBytes(tx->packetSize);
+
+    setPackedForSend(reinterpret_cast<Packet<uint8_t> *>(tx), DEFAULT_PRIORITY + 2);
+}
+
 void LoraMesher::processPackets()
 {
     SAFE_ESP_LOGV("processPackets", "Process routine started.");
@@ -807,36 +1091,41 @@ void LoraMesher::processPackets()
 
         SAFE_ESP_LOGV("processPackets", "Size of Received Packets Queue: %d.", ReceivedPackets->getLength());
 
-        while (ReceivedPackets->getLength() > 0)
+        QueuePacket<Packet<uint8_t>> *rx;
+
+        while ((rx = ReceivedPackets->Pop()) != nullptr)
         {
-            QueuePacket<Packet<uint8_t>> *rx = ReceivedPackets->Pop();
+            uint8_t type = rx->packet->type;
 
-            if (rx)
-            {
-                uint8_t type = rx->packet->type;
+            printHeaderPacket(rx->packet, "received");
 
-                printHeaderPacket(rx->packet, "received");
+            recordState(LM_StateType::STATE_TYPE_RECEIVED, rx->packet);
 
-                recordState(LM_StateType::STATE_TYPE_RECEIVED, rx->packet);
+            incReceivedPayloadBytes(PacketService::getPacketPayloadLengthWithoutControl(rx->packet));
+            incReceivedControlBytes(PacketService::getControlLength(rx->packet));
 
-                incReceivedPayloadBytes(PacketService::getPacketPayloadLengthWithoutControl(rx->packet));
-                incReceivedControlBytes(PacketService::getControlLength(rx->packet));
+            if (PacketService::isHelloPacket(type))
+            {
+                incRecHelloPackets();
 
-                if (PacketService::isHelloPacket(type))
-                {
-                    incRecHelloPackets();
+                if (RoutingTableService::processRoute(reinterpret_cast<RoutePacket *>(rx->packet), rx->snr))
+                    sendFullHelloRequest(rx->packet->src);
 
-                    RoutingTableService::processRoute(reinterpret_cast<RoutePacket *>(rx->packet), rx->snr);
-                    PacketQueueService::deleteQueuePacketAndPacket(rx);
-                }
-                else if (PacketService::isDataPacket(type))
-                    processDataPacket(reinterpret_cast<QueuePacket<DataPacket> *>(rx));
-                else
-                {
-                    SAFE_ESP_LOGW("processPackets", "Packet not identified, deleting it!");
-                    incReceivedNotForMe();
-                    PacketQueueService::deleteQueuePacketAndPacket(rx);
-                }
+                PacketQueueService::deleteQueuePacketAndPacket(rx);
+
+                // Answer the full hello requests without waiting for the next hello
+                if (RoutingTableService::isFullHelloRequested())
+                    xTaskNotifyGive(Hello_TaskHandle);
+            }
+            else if (PacketService::isFloodPacket(type))
+                processFloodPacket(reinterpret_cast<QueuePacket<ControlPacket> *>(rx));
+            else if (PacketService::isDataPacket(type))
+                processDataPacket(reinterpret_cast<QueuePacket<DataPacket> *>(rx));
+            else
+            {
+                SAFE_ESP_LOGW("processPackets", "Packet not identified, deleting it!");
+                incReceivedNotForMe();
+                PacketQueueService::deleteQueuePacketAndPacket(rx);
             }
         }
     }
@@ -880,22 +1169,15 @@ void LoraMesher::queueManager()
         // Record the state for the simulation
         recordState(LM_StateType::STATE_TYPE_MANAGER);
 
-        if (q_WSP->getLength() == 0 && q_WRP->getLength() == 0)
-        {
-            SAFE_ESP_LOGV(LM_TAG, "No packets to send or received");
-
-            // Wait for the notification of send or receive reliable message and enter blocking
-            ulTaskNotifyTake(
-                pdTRUE,
-                portMAX_DELAY);
-            continue;
-        }
+        TickType_t wait = manageTimeouts();
 
-        managerReceivedQueue();
-        managerSendQueue();
+        if (wait == portMAX_DELAY)
+            SAFE_ESP_LOGV(LM_TAG, "No packets to send or received");
 
-        // TODO: Calculate the min timeout for the queue manager, get the min timeout from the queues
-        vTaskDelay(MIN_TIMEOUT * 1000 / portTICK_PERIOD_MS);
+        // Sleep until the next timeout, a new sequence or a changed timeout wakes it up earlier
+        ulTaskNotifyTake(
+            pdTRUE,
+            wait);
     }
 }
 
@@ -920,6 +1202,22 @@ void LoraMesher::sendReliablePacket(uint16_t dst, uint8_t *payload, uint32_t pay
     // Cannot send an empty packet
     if (payloadSize == 0)
         return;
+
+    // Keep a single copy of the payload, the packets are created from it when they are sent
+    sendSequencePayload(dst, new sequencePayload(payload, payloadSize));
+}
+
+void LoraMesher::sendReliableStream(uint16_t dst, uint32_t payloadSize, StreamReader reader, void *context)
+{
+    // Cannot send an empty packet
+    if (payloadSize == 0 || reader == nullptr)
+        return;
+
+    sendSequencePayload(dst, new sequencePayload(payloadSize, reader, context));
+}
+
+void LoraMesher::sendSequencePayload(uint16_t dst, sequencePayload *sPayload)
+{
     if (dst == ADDR_BROADCAST)
     {
         ESP_LOGW(LM_TAG, "Be aware of sending a reliable packet to the broadcast address");
@@ -930,18 +1228,35 @@ void LoraMesher::sendReliablePacket(uint16_t dst, uint8_t *payload, uint32_t pay
             for (size_t i = 0; i < numOfNodes; i++)
             {
                 NetworkNode *node = &nodes[i];
-                sendReliablePacket(node->address, payload, payloadSize);
+                sendReliableSequence(node->address, sPayload);
             }
             delete[] nodes;
         }
-        return;
     }
-    SAFE_ESP_LOGV(LM_TAG, "Sending reliable payload with %d bytes to %X", (int)payloadSize, dst);
+    else
+        sendReliableSequence(dst, sPayload);
+
+    releaseSequencePayload(sPayload);
+}
+
+LoraMesher::sequencePayload *LoraMesher::retainSequencePayload(sequencePayload *payload)
+{
+    payload->references++;
+    return payload;
+}
+
+void LoraMesher::releaseSequencePayload(sequencePayload *payload)
+{
+    if (--payload->references == 0)
+        delete payload;
+}
 
-    // Get the Routing Table node of the destination
-    RouteNode *node = RoutingTableService::findNode(dst);
+void LoraMesher::sendReliableSequence(uint16_t dst, sequencePayload *payload)
+{
+    SAFE_ESP_LOGV(LM_TAG, "Sending reliable payload with %d bytes to %X", (int)payload->payloadSize, dst);
 
-    if (node == NULL)
+    // The destination needs to be inside the routing table
+    if (!RoutingTableService::hasAddressRoutingTable(dst))
     {
         SAFE_ESP_LOGV(LM_TAG, "Destination not found in the routing table");
         return;
@@ -950,49 +1265,27 @@ void LoraMesher::sendReliablePacket(uint16_t dst, uint8_t *payload, uint32_t pay
     // Generate a sequence Id for this list of packets
     uint8_t seq_id = getSequenceId();
 
-    // Get the Type of the packet
-    uint8_t type = NEED_ACK_P | XL_DATA_P;
-
     // Max payload size per packet
-    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(type);
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(NEED_ACK_P | XL_DATA_P);
 
     // Number of packets
-    uint16_t numOfPackets = payloadSize / maxPayloadSize + (payloadSize % maxPayloadSize > 0);
-
-    // Create a new Linked list to store the QueuePackets and the payload
-    LM_LinkedList<QueuePacket<ControlPacket>> *packetList = new LM_LinkedList<QueuePacket<ControlPacket>>();
-
-    // Add the SYNC configuration packet
-    packetList->Append(getStartSequencePacketQueue(dst, seq_id, numOfPackets));
-
-    for (uint16_t i = 1; i <= numOfPackets; i++)
+    uint32_t numOfPackets = payload->payloadSize / maxPayloadSize + (payload->payloadSize % maxPayloadSize > 0);
+    if (numOfPackets > UINT16_MAX)
     {
-        // Get the position of the payload
-        uint8_t *payloadToSend = reinterpret_cast<uint8_t *>((unsigned long)payload + ((i - 1) * maxPayloadSize));
-
-        // Get the payload Size in bytes
-        size_t payloadSizeToSend = maxPayloadSize;
-        if (i == numOfPackets)
-            payloadSizeToSend = payloadSize - (maxPayloadSize * (numOfPackets - 1));
-
-        SAFE_ESP_LOGV(LM_TAG, "Payload Size: %d", payloadSizeToSend);
-
-        // Create a new packet with the previous payload
-        ControlPacket *cPacket = PacketService::createControlPacket(dst, getLocalAddress(), type, payloadToSend, payloadSizeToSend);
-        cPacket->number = i;
-        cPacket->seq_id = seq_id;
-
-        // Create a packet queue
-        QueuePacket<ControlPacket> *pq = PacketQueueService::createQueuePacket(cPacket, DEFAULT_PRIORITY + 1, i);
-
-        // Append the packet queue in the linked list
-        packetList->Append(pq);
+        SAFE_ESP_LOGE(LM_TAG, "Reliable payload too large, %d bytes", (int)payload->payloadSize);
+        return;
     }
 
     // Create the pair of configuration
     listConfiguration *listConfig = new listConfiguration();
-    listConfig->config = new sequencePacketConfig(seq_id, dst, numOfPackets, node);
-    listConfig->list = packetList;
+    listConfig->config = new sequencePacketConfig(seq_id, dst, QueueType::WSP, numOfPackets);
+    listConfig->appPacket = nullptr;
+    listConfig->reorderBuffer = nullptr;
+    listConfig->lastPacketSize = 0;
+    listConfig->payload = retainSequencePayload(payload);
+
+    // Start with one packet in flight and grow exponentially until the maximum window
+    listConfig->config->slowStartThreshold = getMaxWindowSize();
 
     // Set the RTT of the first packet of the sequence
     listConfig->config->calculatingRTT = millis();
@@ -1020,6 +1313,12 @@ void LoraMesher::processDataPacket(QueuePacket<DataPacket> *pq)
 
     SAFE_ESP_LOGI("processDataPacket", "Data packet from %X, destination %X, via %X.", packet->src, packet->dst, packet->via);
 
+    if (PacketService::isAggregatedPacket(packet->type))
+    {
+        processAggregatedPacket(pq);
+        return;
+    }
+
     if (packet->dst == getLocalAddress())
     {
         SAFE_ESP_LOGI("processDataPacket", "Data packet from %X for me.", packet->src);
@@ -1030,16 +1329,38 @@ void LoraMesher::processDataPacket(QueuePacket<DataPacket> *pq)
     }
     else if (packet->dst == ADDR_BROADCAST)
     {
-        //        SAFE_ESP_LOGI("processDataPacket", "Data packet from %X BROADCAST.", packet->src);
-        //        incReceivedBroadcast();
-        //        processDataPacketForMe(pq);
-        SAFE_ESP_LOGW("processDataPacket", "Data packet cannot be broadcast!");
+        // The broadcast data is delivered to the neighbors that hear it, it is not relayed. The whole network
+        // is reached with the flooded packets
+        if (PacketService::isOnlyDataPacket(packet->type))
+        {
+            SAFE_ESP_LOGI("processDataPacket", "Data packet from %X BROADCAST.", packet->src);
+            incReceivedBroadcast();
+            processDataPacketForMe(pq);
+            return;
+        }
+
+        SAFE_ESP_LOGW("processDataPacket", "Data packet with type %d cannot be broadcast!", packet->type);
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
         return;
     }
     else if (packet->via == getLocalAddress())
     {
         SAFE_ESP_LOGI("processDataPacket", "Data Packet from %X for %X. Via is me. Forwarding it.", packet->src, packet->dst);
         incReceivedIAmVia();
+
+        // Only the data packets, the packets of the reliable payloads can be sent again on purpose
+        if (PacketService::isOnlyDataPacket(packet->type) && isDuplicatePacket(reinterpret_cast<Packet<uint8_t> *>(packet)))
+        {
+            SAFE_ESP_LOGI("processDataPacket", "Duplicate data packet from %X for %X. Not forwarding it.", packet->src, packet->dst);
+            incDuplicatePackets();
+            PacketQueueService::deleteQueuePacketAndPacket(pq);
+            return;
+        }
+
+        // Tell the sender of the reliable payload if this node is congested
+        if (PacketService::isAckPacket(packet->type))
+            updateAckQueueDepth(reinterpret_cast<ControlPacket *>(packet));
+
         addToSendOrderedAndNotify(reinterpret_cast<QueuePacket<Packet<uint8_t>> *>(pq));
         return;
     }
@@ -1049,10 +1370,113 @@ void LoraMesher::processDataPacket(QueuePacket<DataPacket> *pq)
     PacketQueueService::deleteQueuePacketAndPacket(pq);
 }
 
-void LoraMesher::processDataPacketForMe(QueuePacket<DataPacket> *pq)
+bool LoraMesher::isDuplicatePacket(Packet<uint8_t> *p)
 {
-    DataPacket *p = pq->packet;
-    ControlPacket *cPacket = reinterpret_cast<ControlPacket *>(p);
+    if (duplicateFilter == nullptr)
+        return false;
+
+    return duplicateFilter->CheckAndInsert(PacketService::getFingerprint(p), millis());
+}
+
+void LoraMesher::sendFloodPacket(uint8_t *payload, uint8_t payloadSize)
+{
+    // Cannot send an empty packet
+    if (payloadSize == 0)
+        return;
+
+    ControlPacket *cPacket = PacketService::createControlPacket(ADDR_BROADCAST, getLocalAddress(), FLOOD_P, payload, payloadSize);
+    cPacket->via = ADDR_BROADCAST;
+    // The seq_id is the number of hops that the packet can still do
+    cPacket->seq_id = loraMesherConfig->floodMaxHops;
+    cPacket->number = FloodService::getNextSequenceNumber();
+
+    // The relays of our own packet are duplicates
+    FloodService::isNew(getLocalAddress(), cPacket->number);
+
+    setPackedForSend(reinterpret_cast<Packet<uint8_t> *>(cPacket), DEFAULT_PRIORITY + 1);
+}
+
+void LoraMesher::processFloodPacket(QueuePacket<ControlPacket> *pq)
+{
+    ControlPacket *packet = pq->packet;
+
+    if (packet->src == getLocalAddress() || !FloodService::isNew(packet->src, packet->number))
+    {
+        SAFE_ESP_LOGV("processFloodPacket", "Duplicate flooded packet from %X, Num: %d", packet->src, packet->number);
+        FloodService::hearCopy(packet->src, packet->number);
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+        return;
+    }
+
+    SAFE_ESP_LOGI("processFloodPacket", "Flooded packet from %X, Num: %d", packet->src, packet->number);
+    incReceivedBroadcast();
+
+    // Notify the user
+    AppPacket<uint8_t> *appPacket = PacketService::createAppPacket(ADDR_BROADCAST, packet->src, packet->payload, PacketService::getPacketPayloadLength(packet));
+    notifyUserReceivedPacket(appPacket);
+
+    // Relay it after a random delay if it can do more hops
+    if (packet->seq_id > 1)
+    {
+        packet->seq_id--;
+
+        if (FloodService::schedule(reinterpret_cast<QueuePacket<Packet<uint8_t>> *>(pq)))
+        {
+            // Recalculate the time until the send task wakes up
+            xTaskNotify(SendData_TaskHandle, 0, eSetValueWithOverwrite);
+            return;
+        }
+
+        SAFE_ESP_LOGW("processFloodPacket", "Too many flooded packets waiting, not relaying it");
+    }
+
+    PacketQueueService::deleteQueuePacketAndPacket(pq);
+}
+
+void LoraMesher::processAggregatedPacket(QueuePacket<DataPacket> *pq)
+{
+    DataPacket *packet = pq->packet;
+
+    if (packet->via != getLocalAddress())
+    {
+        SAFE_ESP_LOGV(LM_TAG, "Aggregated packet not for me, deleting it");
+        incReceivedNotForMe();
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+        return;
+    }
+
+    size_t payloadSize = PacketService::getPacketPayloadLength(reinterpret_cast<Packet<uint8_t> *>(packet));
+    size_t offset = 0;
+
+    while (offset + sizeof(AggregatedRecord) <= payloadSize)
+    {
+        AggregatedRecord *record = reinterpret_cast<AggregatedRecord *>(packet->payload + offset);
+        size_t recordSize = sizeof(AggregatedRecord) + record->payloadSize;
+
+        if (offset + recordSize > payloadSize)
+        {
+            SAFE_ESP_LOGW("processAggregatedPacket", "Aggregated packet from %X malformed, discarding the rest", packet->src);
+            break;
+        }
+
+        // Process each data packet as if it had been received alone
+        DataPacket *dPacket = PacketService::createDataPacket(record->dst, record->src, DATA_P, record->payload, record->payloadSize);
+        dPacket->via = getLocalAddress();
+        dPacket->number = record->number;
+
+        QueuePacket<DataPacket> *dPq = PacketQueueService::createQueuePacket(dPacket, pq->priority, 0, (int8_t)pq->rssi, (int8_t)pq->snr);
+        processDataPacket(dPq);
+
+        offset += recordSize;
+    }
+
+    PacketQueueService::deleteQueuePacketAndPacket(pq);
+}
+
+void LoraMesher::processDataPacketForMe(QueuePacket<DataPacket> *pq)
+{
+    DataPacket *p = pq->packet;
+    ControlPacket *cPacket = reinterpret_cast<ControlPacket *>(p);
 
     // By default, delete the packet queue at the finish of this function
     bool deleteQueuePacket = true;
@@ -1068,10 +1492,15 @@ void LoraMesher::processDataPacketForMe(QueuePacket<DataPacket> *pq)
         // Add and notify the user of this packet
         notifyUserReceivedPacket(appPacket);
     }
+    else if (PacketService::isSackPacket(p->type))
+    {
+        SAFE_ESP_LOGI("processDataPacketForMe", "Selective ACK Packet received.");
+        processSackPacket(p->src, cPacket);
+    }
     else if (PacketService::isAckPacket(p->type))
     {
         SAFE_ESP_LOGI("processDataPacketForMe", "ACK Packet received.");
-        addAck(p->src, cPacket->seq_id, cPacket->number);
+        addAck(p->src, cPacket->seq_id, cPacket->number, getAckQueueDepth(cPacket));
     }
     else if (PacketService::isLostPacket(p->type))
     {
@@ -1081,7 +1510,7 @@ void LoraMesher::processDataPacketForMe(QueuePacket<DataPacket> *pq)
     else if (PacketService::isSyncPacket(p->type))
     {
         SAFE_ESP_LOGI("processDataPacketForMe", "Synchronization Packet received.");
-        processSyncPacket(p->src, cPacket->seq_id, cPacket->number);
+        processSyncPacket(p->src, cPacket->seq_id, cPacket->number, PacketService::getPacketPayloadLength(cPacket) > 0 ? cPacket->payload[0] : 0);
 
         needAck = false;
     }
@@ -1126,14 +1555,6 @@ void LoraMesher::notifyUserReceivedPacket(AppPacket<uint8_t> *appPacket)
         deletePacket(appPacket);
 }
 
-uint32_t LoraMesher::getPropagationTimeWithRandom(uint8_t multiplayer)
-{
-    // TODO: Use the RTT or other congestion metrics to calculate the time, timeouts...
-    uint32_t time = getMaxPropagationTime();
-    uint32_t randomTime = random(time, time * 3 + (multiplayer + routingTableSize()) * 100);
-    return randomTime;
-}
-
 void LoraMesher::recalculateMaxTimeOnAir()
 {
     maxTimeOnAir = radio->getTimeOnAir(PacketFactory::getMaxPacketSize()) / 1000;
@@ -1200,9 +1621,24 @@ size_t LoraMesher::getSendQueueSize()
     return ToSendPackets->getLength();
 }
 
+size_t LoraMesher::getSendQueuePeakSize()
+{
+    return ToSendPackets->getPeakLength();
+}
+
+uint32_t LoraMesher::getSendQueueOverflowsNum()
+{
+    return ToSendPackets->getOverflows();
+}
+
 void LoraMesher::addToSendOrderedAndNotify(QueuePacket<Packet<uint8_t>> *qp)
 {
-    PacketQueueService::addOrdered(ToSendPackets, qp);
+    if (!PacketQueueService::addOrdered(ToSendPackets, qp))
+    {
+        PacketQueueService::deleteQueuePacketAndPacket(qp);
+        return;
+    }
+
     SAFE_ESP_LOGV("addToSendOrderedAndNotify", "Added packet to Q_SP, notifying sender task.");
 
     // Notify the sendData task handle
@@ -1223,27 +1659,75 @@ void LoraMesher::notifyNewSequenceStarted()
  * Large and Reliable payloads
  */
 
-QueuePacket<ControlPacket> *LoraMesher::getStartSequencePacketQueue(uint16_t destination, uint8_t seq_id, uint16_t num_packets)
+ControlPacket *LoraMesher::getStartSequencePacket(uint16_t destination, uint8_t seq_id, uint16_t num_packets, uint8_t flags)
 {
     uint8_t type = SYNC_P | NEED_ACK_P | XL_DATA_P;
 
     // Create the packet
-    ControlPacket *cPacket = PacketService::createEmptyControlPacket(destination, getLocalAddress(), type, seq_id, num_packets);
+    if (flags == 0)
+        return PacketService::createEmptyControlPacket(destination, getLocalAddress(), type, seq_id, num_packets);
+
+    ControlPacket *cPacket = PacketService::createControlPacket(destination, getLocalAddress(), type, &flags, 1);
+    cPacket->seq_id = seq_id;
+    cPacket->number = num_packets;
 
-    // Create a packet queue
-    return PacketQueueService::createQueuePacket(cPacket, DEFAULT_PRIORITY, 0);
+    return cPacket;
 }
 
 void LoraMesher::sendAckPacket(uint16_t destination, uint8_t seq_id, uint16_t seq_num)
 {
     uint8_t type = ACK_P;
 
-    // Create the packet
-    ControlPacket *cPacket = PacketService::createEmptyControlPacket(destination, getLocalAddress(), type, seq_id, seq_num);
+    // Create the packet, with the send queue depth of this node
+    uint8_t queueDepth = getSendQueueDepth();
+    ControlPacket *cPacket = PacketService::createControlPacket(destination, getLocalAddress(), type, &queueDepth, 1);
+    cPacket->seq_id = seq_id;
+    cPacket->number = seq_num;
 
     setPackedForSend(reinterpret_cast<Packet<uint8_t> *>(cPacket), DEFAULT_PRIORITY + 3);
 }
 
+uint8_t LoraMesher::getAdvertisedRole()
+{
+    uint8_t role = RoleService::getRole() & ROLE_MASK;
+
+    if ((role & (ROLE_CLIENT | ROLE_GATEWAY)) == 0)
+        return role;
+
+    uint8_t load = LM_UPLINK_LOAD_MAX;
+
+    if ((role & ROLE_CLIENT) == 0 || WiFiTransmitter::getInstance().isWiFiConnected())
+    {
+        size_t pending = getReceivedQueueSize();
+        load = pending >= LM_UPLINK_QUEUE_FULL ? LM_UPLINK_LOAD_MAX : pending * (LM_UPLINK_LOAD_MAX + 1) / LM_UPLINK_QUEUE_FULL;
+    }
+
+    return role | (load << LM_UPLINK_LOAD_SHIFT);
+}
+
+uint8_t LoraMesher::getSendQueueDepth()
+{
+    size_t length = ToSendPackets->getLength();
+    return length > UINT8_MAX ? UINT8_MAX : length;
+}
+
+uint8_t LoraMesher::getAckQueueDepth(ControlPacket *cPacket)
+{
+    size_t payloadSize = PacketService::getPacketPayloadLength(cPacket);
+    return payloadSize == 0 ? 0 : cPacket->payload[payloadSize - 1];
+}
+
+void LoraMesher::updateAckQueueDepth(ControlPacket *cPacket)
+{
+    size_t payloadSize = PacketService::getPacketPayloadLength(cPacket);
+    if (payloadSize == 0)
+        return;
+
+    uint8_t queueDepth = getSendQueueDepth();
+    if (queueDepth > cPacket->payload[payloadSize - 1])
+        cPacket->payload[payloadSize - 1] = queueDepth;
+}
+
 void LoraMesher::sendLostPacket(uint16_t destination, uint8_t seq_id, uint16_t seq_num)
 {
     uint8_t type = LOST_P;
@@ -1254,6 +1738,112 @@ void LoraMesher::sendLostPacket(uint16_t destination, uint8_t seq_id, uint16_t s
     setPackedForSend(reinterpret_cast<Packet<uint8_t> *>(cPacket), DEFAULT_PRIORITY + 2);
 }
 
+void LoraMesher::sendSackPacket(sequencePacketConfig *config)
+{
+    uint8_t type = SACK_P;
+
+    // Only the beginning of the bitmap that fits inside the packet, the last byte is the send queue depth
+    size_t bitmapSize = config->receivedBitmapSize;
+    size_t maxBitmapSize = PacketService::getMaximumPayloadLength(type) - 1;
+    if (bitmapSize > maxBitmapSize)
+        bitmapSize = maxBitmapSize;
+
+    // Create the packet, the bitmap followed by the send queue depth of this node
+    uint8_t *payload = new uint8_t[bitmapSize + 1];
+    memcpy(payload, config->receivedBitmap, bitmapSize);
+    payload[bitmapSize] = getSendQueueDepth();
+
+    ControlPacket *cPacket = PacketService::createControlPacket(config->source, getLocalAddress(), type, payload, bitmapSize + 1);
+    delete[] payload;
+
+    cPacket->seq_id = config->seq_id;
+    cPacket->number = config->lastAck;
+
+    setPackedForSend(reinterpret_cast<Packet<uint8_t> *>(cPacket), DEFAULT_PRIORITY + 3);
+}
+
+void LoraMesher::processSackPacket(uint16_t source, ControlPacket *cPacket)
+{
+    listConfiguration *listConfig = findSequenceList(q_WSP, cPacket->seq_id, source);
+    if (listConfig == nullptr)
+    {
+        SAFE_ESP_LOGE(LM_TAG, "NOT FOUND the sequence packet config in selective ACK with Seq_id: %d, Source: %d", cPacket->seq_id, source);
+        return;
+    }
+
+    sequencePacketConfig *config = listConfig->config;
+    uint16_t base = cPacket->number;
+    size_t payloadSize = PacketService::getPacketPayloadLength(cPacket);
+    if (payloadSize == 0)
+    {
+        SAFE_ESP_LOGW(LM_TAG, "Malformed selective ACK Seq_id: %d", config->seq_id);
+        return;
+    }
+
+    // The last byte is the send queue depth
+    size_t bitmapSize = payloadSize - 1;
+
+    if (base == config->number)
+    {
+        ESP_LOGI(LM_TAG, "All the packets has been arrived to the seq_Id: %d", config->seq_id);
+        findAndClearLinkedList(q_WSP, listConfig);
+        return;
+    }
+
+    if (base < config->lastAck)
+    {
+        SAFE_ESP_LOGW(LM_TAG, "Old selective ACK Seq_id: %d, Num: %d", config->seq_id, base);
+        return;
+    }
+
+    // Recalculate the RTT if the packet being timed has been acknowledged
+    if (config->rttNumber != 0 && base >= config->rttNumber)
+    {
+        actualizeRTT(config);
+        config->rttNumber = 0;
+    }
+
+    uint16_t acked = base - config->lastAck;
+
+    config->firstAckReceived = 1;
+    config->lastAck = base;
+
+    // Find the last packet received, the missing ones are before it
+    int32_t lastReceived = LM_SackBitmap::Last(cPacket->payload, bitmapSize);
+
+    // Send all the missing packets in one burst
+    for (int32_t bit = 0; bit < lastReceived; bit++)
+    {
+        if (LM_SackBitmap::Get(cPacket->payload, bitmapSize, bit))
+            continue;
+
+        uint16_t seq_num = base + 1 + bit;
+
+        // A retransmitted packet can not be used to calculate the RTT (Karn's algorithm)
+        if (config->rttNumber == seq_num)
+            config->rttNumber = 0;
+
+        SAFE_ESP_LOGV(LM_TAG, "Sending again Seq_id: %d, Num: %d", config->seq_id, seq_num);
+        if (sendPacketSequence(listConfig, seq_num))
+            incResentPackets();
+    }
+
+    // Missing packets or a congested node in the path reduce the window
+    if (lastReceived > 0 || cPacket->payload[bitmapSize] >= loraMesherConfig->congestionQueueThreshold)
+        decreaseCongestionWindow(config);
+    else
+        increaseCongestionWindow(config, acked);
+
+    // The destination is reachable through the actual next hop
+    RoutingTableService::reportNextHopSuccess(source);
+
+    // Reset the timeout
+    resetTimeout(config);
+
+    // Fill the window again
+    sendSequenceWindow(listConfig);
+}
+
 bool LoraMesher::sendPacketSequence(listConfiguration *lstConfig, uint16_t seq_num)
 {
     // Check if the sequence number requested is valid
@@ -1263,25 +1853,60 @@ bool LoraMesher::sendPacketSequence(listConfiguration *lstConfig, uint16_t seq_n
         return false;
     }
 
-    // Get the packet queue with the sequence number
-    QueuePacket<ControlPacket> *pq = PacketQueueService::findPacketQueue(lstConfig->list, seq_num);
+    sequencePacketConfig *config = lstConfig->config;
 
-    if (pq == nullptr)
+    if (seq_num > config->number)
     {
-        SAFE_ESP_LOGE(LM_TAG, "NOT FOUND the packet queue with Seq_id: %d, Num: %d", lstConfig->config->seq_id, seq_num);
+        SAFE_ESP_LOGE(LM_TAG, "NOT FOUND the packet with Seq_id: %d, Num: %d", config->seq_id, seq_num);
         return false;
     }
 
-    // Create the packet
-    Packet<uint8_t> *p = PacketService::copyPacket(pq->packet, pq->packet->getPacketLength());
+    ControlPacket *cPacket;
+
+    sequencePayload *payload = lstConfig->payload;
+
+    if (seq_num == 0)
+        cPacket = getStartSequencePacket(config->source, config->seq_id, config->number, payload->reader != nullptr ? SYNC_STREAM_F : 0);
+    else
+    {
+        // Create the packet from its part of the payload
+        uint8_t type = NEED_ACK_P | XL_DATA_P;
+        size_t maxPayloadSize = PacketService::getMaximumPayloadLength(type);
+
+        uint32_t offset = (seq_num - 1) * maxPayloadSize;
+        size_t payloadSizeToSend = payload->payloadSize - offset;
+        if (payloadSizeToSend > maxPayloadSize)
+            payloadSizeToSend = maxPayloadSize;
+
+        if (payload->reader == nullptr)
+            cPacket = PacketService::createControlPacket(config->source, getLocalAddress(), type, payload->payload + offset, payloadSizeToSend);
+        else
+        {
+            // Read the part of the payload directly inside the packet
+            cPacket = PacketService::createControlPacket(config->source, getLocalAddress(), type, nullptr, payloadSizeToSend);
+
+            if (cPacket == nullptr)
+                return false;
+
+            if (payload->reader(cPacket->payload, offset, payloadSizeToSend, payload->context) != payloadSizeToSend)
+            {
+                SAFE_ESP_LOGW(LM_TAG, "Stream not ready Seq_id: %d, Num: %d", config->seq_id, seq_num);
+                delete cPacket;
+                return false;
+            }
+        }
+
+        cPacket->number = seq_num;
+        cPacket->seq_id = config->seq_id;
+    }
 
     // Add the packet to the send queue
-    setPackedForSend(p, DEFAULT_PRIORITY);
+    setPackedForSend(reinterpret_cast<Packet<uint8_t> *>(cPacket), DEFAULT_PRIORITY);
 
     return true;
 }
 
-void LoraMesher::addAck(uint16_t source, uint8_t seq_id, uint16_t seq_num)
+void LoraMesher::addAck(uint16_t source, uint8_t seq_id, uint16_t seq_num, uint8_t queueDepth)
 {
     listConfiguration *config = findSequenceList(q_WSP, seq_id, source);
     if (config == nullptr)
@@ -1305,24 +1930,116 @@ void LoraMesher::addAck(uint16_t source, uint8_t seq_id, uint16_t seq_num)
         return;
     }
 
+    // The ACKs are cumulative, a repeated one does not acknowledge anything new
+    if (config->config->firstAckReceived && config->config->lastAck == seq_num)
+    {
+        SAFE_ESP_LOGV(LM_TAG, "Repeated ACK Seq_id: %d, Num: %d", config->config->seq_id, seq_num);
+        return;
+    }
+
+    // Recalculate the RTT, only with the SYNC packet or the packet being timed
+    if ((config->config->firstAckReceived == 0 && seq_num == 0) ||
+        (config->config->rttNumber != 0 && seq_num >= config->config->rttNumber))
+    {
+        actualizeRTT(config->config);
+        config->config->rttNumber = 0;
+    }
+
+    uint16_t acked = config->config->firstAckReceived ? seq_num - config->config->lastAck : 0;
+
     // Set has been received some ACK
     config->config->firstAckReceived = 1;
 
-    // TODO: Check for repeated ACKs and packets.
-
     // Add the last ack to the config packet
     config->config->lastAck = seq_num;
 
-    // Recalculate the RTT
-    actualizeRTT(config->config);
+    // A congested node in the path reduces the window
+    if (queueDepth >= loraMesherConfig->congestionQueueThreshold)
+        decreaseCongestionWindow(config->config);
+    else
+        increaseCongestionWindow(config->config, acked);
+
+    // The destination is reachable through the actual next hop
+    RoutingTableService::reportNextHopSuccess(source);
 
     // Reset the timeouts
     resetTimeout(config->config);
 
-    SAFE_ESP_LOGV(LM_TAG, "Sending next packet after receiving an ACK");
+    SAFE_ESP_LOGV(LM_TAG, "Sending next packets after receiving an ACK");
+
+    // Send the next packets that fit inside the window
+    sendSequenceWindow(config);
+}
+
+void LoraMesher::sendSequenceWindow(listConfiguration *lstConfig)
+{
+    sequencePacketConfig *config = lstConfig->config;
+
+    uint8_t windowSize = config->congestionWindow;
+
+    uint16_t lastInWindow = config->lastAck + windowSize;
+    if (lastInWindow > config->number || lastInWindow < config->lastAck)
+        lastInWindow = config->number;
+
+    uint16_t next = config->lastSent > config->lastAck ? config->lastSent + 1 : config->lastAck + 1;
 
-    // Send the next packet sequence
-    sendPacketSequence(config, seq_num + 1);
+    for (; next <= lastInWindow; next++)
+    {
+        if (!sendPacketSequence(lstConfig, next))
+            break;
+
+        config->lastSent = next;
+
+        // The payload, if it is not streamed, and the packets not acknowledged yet
+        updateReliableSendPeakBytes((lstConfig->payload->payload != nullptr ? lstConfig->payload->payloadSize : 0) +
+            (config->lastSent - config->lastAck) * (sizeof(ControlPacket) + PacketService::getMaximumPayloadLength(NEED_ACK_P | XL_DATA_P)));
+
+        // Time one packet at a time to calculate the RTT
+        if (config->rttNumber == 0)
+        {
+            config->rttNumber = next;
+            config->calculatingRTT = millis();
+        }
+    }
+}
+
+void LoraMesher::increaseCongestionWindow(sequencePacketConfig *config, uint16_t acked)
+{
+    uint8_t maxWindowSize = getMaxWindowSize();
+
+    if (config->congestionWindow < config->slowStartThreshold)
+    {
+        uint16_t window = config->congestionWindow + acked;
+        config->congestionWindow = window > config->slowStartThreshold ? config->slowStartThreshold : window;
+    }
+    else
+    {
+        config->ackedInWindow += acked > UINT8_MAX ? UINT8_MAX : acked;
+        if (config->ackedInWindow >= config->congestionWindow)
+        {
+            config->ackedInWindow = 0;
+            config->congestionWindow++;
+        }
+    }
+
+    if (config->congestionWindow > maxWindowSize)
+        config->congestionWindow = maxWindowSize;
+}
+
+void LoraMesher::decreaseCongestionWindow(sequencePacketConfig *config)
+{
+    // Already reduced for the packets in flight
+    if (config->lastAck < config->recoveryNumber)
+        return;
+
+    config->slowStartThreshold = config->congestionWindow / 2 > 1 ? config->congestionWindow / 2 : 1;
+    config->congestionWindow = config->slowStartThreshold;
+    config->ackedInWindow = 0;
+    config->recoveryNumber = config->lastSent;
+
+    incCongestionEvents();
+
+    SAFE_ESP_LOGW(LM_TAG, "Congestion window reduced to %d, Seq_id: %d", config->congestionWindow, config->seq_id);
 }
 
 bool LoraMesher::processLargePayloadPacket(QueuePacket<ControlPacket> *pq)
@@ -1337,32 +2054,75 @@ bool LoraMesher::processLargePayloadPacket(QueuePacket<ControlPacket> *pq)
         return false;
     }
 
-    if (configList->config->lastAck + 1 != cPacket->number)
+    sequencePacketConfig *config = configList->config;
+    uint16_t source = cPacket->src;
+    uint8_t seq_id = cPacket->seq_id;
+    uint16_t number = cPacket->number;
+
+    if (number <= config->lastAck)
     {
-        SAFE_ESP_LOGE(LM_TAG, "Sequence number received in bad order in seq_Id: %d, received: %d expected: %d", cPacket->seq_id, cPacket->number, configList->config->lastAck + 1);
-        sendLostPacket(cPacket->src, cPacket->seq_id, configList->config->lastAck + 1);
+        // Already received, the ACK could have been lost
+        SAFE_ESP_LOGW(LM_TAG, "Repeated sequence number in seq_Id: %d, received: %d", seq_id, number);
+        sendAckPacket(source, seq_id, config->lastAck);
 
         PacketQueueService::deleteQueuePacketAndPacket(pq);
         return false;
     }
 
-    configList->config->lastAck++;
+    if (config->lastAck + 1 != number)
+    {
+        SAFE_ESP_LOGW(LM_TAG, "Sequence number received in bad order in seq_Id: %d, received: %d expected: %d", seq_id, number, config->lastAck + 1);
 
-    configList->list->setInUse();
-    configList->list->Append(pq);
-    configList->list->releaseInUse();
+        // Keep it only if it is inside the window
+        if (number <= config->lastAck + getMaxWindowSize() && !config->isReceived(number) && copyLargePayloadPacket(configList, cPacket))
+            config->setReceived(number);
 
-    // Send ACK
-    sendAckPacket(cPacket->src, cPacket->seq_id, cPacket->number);
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+
+        // Ask only once for the missing packets
+        if (config->lostRequested != config->lastAck + 1)
+        {
+            config->lostRequested = config->lastAck + 1;
+            sendSackPacket(config);
+        }
+
+        return false;
+    }
+
+    bool copied = copyLargePayloadPacket(configList, cPacket);
+
+    // The frame is not needed anymore, the payload is inside the app packet
+    PacketQueueService::deleteQueuePacketAndPacket(pq);
+
+    if (!copied)
+        return false;
+
+    config->incrementLastAck();
+
+    // Move after the following packets that were received out of order
+    if (configList->reorderBuffer != nullptr)
+        deliverStreamReorderBuffer(configList);
+    else
+        while (config->isReceived(config->lastAck + 1))
+            config->incrementLastAck();
+
+    // Send a cumulative ACK, with the packets received after the missing ones if any
+    if (config->hasReceivedOutOfOrder())
+    {
+        config->lostRequested = config->lastAck + 1;
+        sendSackPacket(config);
+    }
+    else
+        sendAckPacket(source, seq_id, config->lastAck);
 
     // Recalculate the RTT
-    actualizeRTT(configList->config);
+    actualizeRTT(config);
 
     // Reset the timeouts
-    resetTimeout(configList->config);
+    resetTimeout(config);
 
-    // All packets has been arrived, join them and send to the user
-    if (configList->config->lastAck == configList->config->number)
+    // All packets has been arrived, send it to the user
+    if (config->lastAck == config->number)
     {
         joinPacketsAndNotifyUser(configList);
         return true;
@@ -1371,98 +2131,147 @@ bool LoraMesher::processLargePayloadPacket(QueuePacket<ControlPacket> *pq)
     return true;
 }
 
-void LoraMesher::joinPacketsAndNotifyUser(listConfiguration *listConfig)
+bool LoraMesher::copyLargePayloadPacket(listConfiguration *lstConfig, ControlPacket *cPacket)
 {
-    SAFE_ESP_LOGV(LM_TAG, "Joining packets seq_Id: %d Src: %X", listConfig->config->seq_id, listConfig->config->source);
-
-    LM_LinkedList<QueuePacket<ControlPacket>> *list = listConfig->list;
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(NEED_ACK_P | XL_DATA_P);
+    size_t payloadSize = PacketService::getPacketPayloadLength(cPacket);
 
-    list->setInUse();
-    if (!list->moveToStart())
+    // All the packets are full except the last one
+    if (cPacket->number == 0 || cPacket->number > lstConfig->config->number || payloadSize > maxPayloadSize ||
+        (cPacket->number != lstConfig->config->number && payloadSize != maxPayloadSize))
     {
-        list->releaseInUse();
-        return;
+        SAFE_ESP_LOGE(LM_TAG, "Wrong packet size in seq_Id: %d, Num: %d, Size: %d", cPacket->seq_id, cPacket->number, payloadSize);
+        return false;
     }
 
-    // TODO: getPacketPayloadLength could be done when adding the packets inside the list
-    size_t payloadSize = 0;
-    size_t number = 1;
-
-    do
+    if (lstConfig->reorderBuffer != nullptr)
     {
-        ControlPacket *currentP = reinterpret_cast<ControlPacket *>(list->getCurrent()->packet);
+        // Deliver it now if it is the next one, otherwise keep it in its slot
+        if (cPacket->number == lstConfig->config->lastAck + 1)
+            deliverStreamPacket(lstConfig, cPacket->number, cPacket->payload, payloadSize);
+        else
+        {
+            memcpy(lstConfig->reorderBuffer + (cPacket->number % getMaxWindowSize()) * maxPayloadSize, cPacket->payload, payloadSize);
 
-        if (number != (currentP->number))
-            // TODO: ORDER THE PACKETS if they are not ordered?
-            SAFE_ESP_LOGE(LM_TAG, "Wrong packet order");
+            if (cPacket->number == lstConfig->config->number)
+                lstConfig->lastPacketSize = payloadSize;
+        }
 
-        number++;
-        payloadSize += PacketService::getPacketPayloadLength(currentP);
-    } while (list->next());
+        return true;
+    }
 
-    // Move to start again
-    list->moveToStart();
+    AppPacket<uint8_t> *appPacket = lstConfig->appPacket;
+    if (appPacket == nullptr)
+        return false;
 
-    ControlPacket *currentP = list->getCurrent()->packet;
+    size_t offset = (cPacket->number - 1) * maxPayloadSize;
+    memcpy(appPacket->payload + offset, cPacket->payload, payloadSize);
 
-    uint32_t appPacketLength = sizeof(AppPacket<uint8_t>);
+    // The last packet gives the size of the payload
+    if (cPacket->number == lstConfig->config->number)
+        appPacket->payloadSize = offset + payloadSize;
 
-    // Packet length = size of the packet + size of the payload
-    uint32_t packetLength = appPacketLength + payloadSize;
+    return true;
+}
 
-    AppPacket<uint8_t> *p = static_cast<AppPacket<uint8_t> *>(pvPortMalloc(packetLength));
+void LoraMesher::deliverStreamPacket(listConfiguration *lstConfig, uint16_t seq_num, uint8_t *data, size_t size)
+{
+    StreamReceiver receiver = streamReceiver;
+    if (receiver == nullptr)
+        return;
 
-    SAFE_ESP_LOGV(LM_TAG, "Large Packet Packet length: %d Payload Size: %d", (int)packetLength, payloadSize);
+    sequencePacketConfig *config = lstConfig->config;
+    uint32_t offset = (seq_num - 1) * PacketService::getMaximumPayloadLength(NEED_ACK_P | XL_DATA_P);
 
-    if (p)
-    {
-        // Copy the payload into the packet
-        unsigned long actualPayloadSizeDst = appPacketLength;
+    receiver(config->source, config->seq_id, offset, data, size, seq_num == config->number, streamReceiverContext);
+}
 
-        do
-        {
-            currentP = list->getCurrent()->packet;
+void LoraMesher::deliverStreamReorderBuffer(listConfiguration *lstConfig)
+{
+    sequencePacketConfig *config = lstConfig->config;
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(NEED_ACK_P | XL_DATA_P);
 
-            size_t actualPayloadSizeSrc = PacketService::getPacketPayloadLength(currentP);
+    while (config->isReceived(config->lastAck + 1))
+    {
+        uint16_t seq_num = config->lastAck + 1;
+        size_t size = seq_num == config->number ? lstConfig->lastPacketSize : maxPayloadSize;
 
-            memcpy(reinterpret_cast<void *>((unsigned long)p + (actualPayloadSizeDst)), currentP->payload, actualPayloadSizeSrc);
-            actualPayloadSizeDst += actualPayloadSizeSrc;
-        } while (list->next());
+        deliverStreamPacket(lstConfig, seq_num, lstConfig->reorderBuffer + (seq_num % getMaxWindowSize()) * maxPayloadSize, size);
+        config->incrementLastAck();
     }
+}
 
-    list->releaseInUse();
+void LoraMesher::joinPacketsAndNotifyUser(listConfiguration *listConfig)
+{
+    SAFE_ESP_LOGV(LM_TAG, "Large payload received seq_Id: %d Src: %X", listConfig->config->seq_id, listConfig->config->source);
 
-    // Set values to the AppPacket
-    p->payloadSize = payloadSize;
-    p->src = listConfig->config->source;
-    p->dst = getLocalAddress();
+    AppPacket<uint8_t> *p = listConfig->appPacket;
+    listConfig->appPacket = nullptr;
 
     // TODO: When finished, clear everything? Or maintain the config until timeout?
     findAndClearLinkedList(q_WRP, listConfig);
 
+    if (p == nullptr)
+        return;
+
     notifyUserReceivedPacket(p);
 }
 
-void LoraMesher::processSyncPacket(uint16_t source, uint8_t seq_id, uint16_t seq_num)
+void LoraMesher::processSyncPacket(uint16_t source, uint8_t seq_id, uint16_t seq_num, uint8_t flags)
 {
     // Check for repeated sequence lists
     listConfiguration *listConfig = findSequenceList(q_WRP, seq_id, source);
 
     if (listConfig == nullptr)
     {
-        // Get the Routing Table node of the destination
-        RouteNode *node = RoutingTableService::findNode(source);
-
-        if (node == nullptr)
+        // The source needs to be inside the routing table
+        if (!RoutingTableService::hasAddressRoutingTable(source))
         {
             ESP_LOGW(LM_TAG, "Node not found in the routing table");
             return;
         }
 
+        size_t maxPayloadSize = PacketService::getMaximumPayloadLength(NEED_ACK_P | XL_DATA_P);
+        uint8_t windowSize = getMaxWindowSize();
+
+        AppPacket<uint8_t> *appPacket = nullptr;
+        uint8_t *reorderBuffer = nullptr;
+
+        if ((flags & SYNC_STREAM_F) && streamReceiver != nullptr)
+        {
+            // Keep only the packets received out of order, the others are delivered when they arrive
+            reorderBuffer = new uint8_t[windowSize * maxPayloadSize];
+        }
+        else
+        {
+            // Allocate the whole payload, the packets are copied inside it when they arrive
+            uint32_t appPacketLength = sizeof(AppPacket<uint8_t>) + seq_num * maxPayloadSize;
+            appPacket = static_cast<AppPacket<uint8_t> *>(MemoryPoolService::allocatePacket(appPacketLength));
+
+            if (appPacket == nullptr)
+            {
+                SAFE_ESP_LOGE(LM_TAG, "Not enough memory to receive the large payload Seq_id: %d, Source: %X", seq_id, source);
+                return;
+            }
+
+            appPacket->dst = getLocalAddress();
+            appPacket->src = source;
+            appPacket->payloadSize = 0;
+        }
+
         // Create the pair of configuration
         listConfig = new listConfiguration();
-        listConfig->config = new sequencePacketConfig(seq_id, source, seq_num, node);
-        listConfig->list = new LM_LinkedList<QueuePacket<ControlPacket>>();
+        listConfig->config = new sequencePacketConfig(seq_id, source, QueueType::WRP, seq_num);
+        listConfig->appPacket = appPacket;
+        listConfig->reorderBuffer = reorderBuffer;
+        listConfig->lastPacketSize = 0;
+        listConfig->payload = nullptr;
+
+        // One bit for each packet of the window
+        size_t bitmapSize = (windowSize + 7) / 8;
+
+        listConfig->config->receivedBitmapSize = bitmapSize;
+        listConfig->config->receivedBitmap = new uint8_t[bitmapSize]();
 
         // Starting to calculate RTT
         actualizeRTT(listConfig->config);
@@ -1496,8 +2305,9 @@ void LoraMesher::processLostPacket(uint16_t destination, uint8_t seq_id, uint16_
     }
 
     // TODO: Check for duplicate consecutive lost packets, set a timeout to resend the lost packet.
-    //  Recalculate the RTT
-    actualizeRTT(listConfig->config);
+    // A retransmitted packet can not be used to calculate the RTT (Karn's algorithm)
+    if (listConfig->config->rttNumber == seq_num)
+        listConfig->config->rttNumber = 0;
 
     // Reset the timeout
     resetTimeout(listConfig->config);
@@ -1506,13 +2316,24 @@ void LoraMesher::processLostPacket(uint16_t destination, uint8_t seq_id, uint16_
     // If the first sync is received but the first ack is not, then the receiver will send a first lost packet.
     listConfig->config->firstAckReceived = 1;
 
+    // All the packets before the lost one have been received
+    if (seq_num > 0 && seq_num - 1 > listConfig->config->lastAck)
+        listConfig->config->lastAck = seq_num - 1;
+
+    // A lost packet reduces the window
+    decreaseCongestionWindow(listConfig->config);
+
     // Send the packet sequence that has been lost
     if (sendPacketSequence(listConfig, seq_num))
     {
+        incResentPackets();
         listConfig->config->numberOfTimeouts++;
         // Reset the timeout of this sequence packets inside the q_WSP
         recalculateTimeoutAfterTimeout(listConfig->config);
     }
+
+    // Fill the window again
+    sendSequenceWindow(listConfig);
 }
 
 void LoraMesher::addTimeout(LM_LinkedList<listConfiguration> *queue, uint8_t seq_id, uint16_t source)
@@ -1544,53 +2365,35 @@ void LoraMesher::actualizeRTT(sequencePacketConfig *config)
         return;
     }
 
-    RouteNode *node = config->node;
+    unsigned long actualRTT = std::min(millis() - config->calculatingRTT, 100000UL);
+    unsigned long SRTT, RTTVAR;
 
-    if (node == nullptr)
+    // The route can be removed while the sequence is alive, it is found again by the address
+    if (!RoutingTableService::updateRouteRTT(config->source, actualRTT, SRTT, RTTVAR))
     {
         ESP_LOGW(LM_TAG, "Node not found in the routing table");
         return;
     }
 
-    unsigned long actualRTT = millis() - config->calculatingRTT;
-
-    // First time RTT is calculated for this node (RFC 6298)
-    if (node->SRTT == 0)
-    {
-        node->SRTT = actualRTT;
-        node->RTTVAR = actualRTT / 2;
-    }
-    else
-    {
-        unsigned long absRTT = (node->SRTT > actualRTT) ? (node->SRTT - actualRTT) : (actualRTT - node->SRTT);
-        node->RTTVAR = std::min((node->RTTVAR * 3 + absRTT) / 4, 100000UL);
-        node->SRTT = std::min((node->SRTT * 7 + actualRTT) / 8, 100000UL);
-    }
-
     config->calculatingRTT = millis();
 
     SAFE_ESP_LOGV(LM_TAG, "Updating RTT (%u ms), SRTT (%u), RTTVAR (%u) seq_Id: %d Src: %X",
-                  (unsigned int)actualRTT, (unsigned int)node->SRTT, (unsigned int)node->RTTVAR, config->seq_id, config->source);
+                  (unsigned int)actualRTT, (unsigned int)SRTT, (unsigned int)RTTVAR, config->seq_id, config->source);
 }
 
 void LoraMesher::clearLinkedList(listConfiguration *listConfig)
 {
-    LM_LinkedList<QueuePacket<ControlPacket>> *list = listConfig->list;
-    list->setInUse();
     ESP_LOGI(LM_TAG, "Clearing list configuration Seq_Id: %d Src: %X", listConfig->config->seq_id, listConfig->config->source);
 
-    size_t listSize = list->getLength();
+    if (listConfig->appPacket != nullptr)
+        deletePacket(listConfig->appPacket);
 
-    SAFE_ESP_LOGV(LM_TAG, "List size: %d", listSize);
+    delete[] listConfig->reorderBuffer;
 
-    for (int i = 0; i < listSize; i++)
-    {
-        QueuePacket<ControlPacket> *current = list->getCurrent();
-        PacketQueueService::deleteQueuePacketAndPacket(current);
-        list->DeleteCurrent();
-    }
+    if (listConfig->payload != nullptr)
+        releaseSequencePayload(listConfig->payload);
 
-    delete list;
+    cancelTimeout(listConfig->config);
     delete listConfig->config;
     delete listConfig;
 }
@@ -1636,20 +2439,46 @@ LoraMesher::listConfiguration *LoraMesher::findSequenceList(LM_LinkedList<listCo
     return nullptr;
 }
 
-void LoraMesher::managerReceivedQueue()
+TickType_t LoraMesher::manageTimeouts()
 {
-    managerTimeouts(q_WRP, QueueType::WRP);
-}
+    SAFE_ESP_LOGV(LM_TAG, "Checking timeouts. Open connections %d received, %d sent", q_WRP->getLength(), q_WSP->getLength());
 
-void LoraMesher::managerSendQueue()
-{
-    managerTimeouts(q_WSP, QueueType::WSP);
+    // Always in the same order, Q_WRP, Q_WSP and the timeouts
+    q_WRP->setInUse();
+    q_WSP->setInUse();
+
+    for (;;)
+    {
+        sequenceTimeouts->setInUse();
+        sequencePacketConfig *configPacket = sequenceTimeouts->PopExpired(millis());
+        sequenceTimeouts->releaseInUse();
+
+        if (configPacket == nullptr)
+            break;
+
+        manageTimeout(configPacket->queueType == QueueType::WRP ? q_WRP : q_WSP, configPacket);
+    }
+
+    TickType_t wait = portMAX_DELAY;
+
+    sequenceTimeouts->setInUse();
+    if (sequenceTimeouts->getLength() > 0)
+    {
+        long remaining = (long)(sequenceTimeouts->getFirstDeadline() - millis());
+        wait = remaining > 0 ? pdMS_TO_TICKS(remaining) + 1 : 0;
+    }
+    sequenceTimeouts->releaseInUse();
+
+    q_WSP->releaseInUse();
+    q_WRP->releaseInUse();
+
+    return wait;
 }
 
-void LoraMesher::managerTimeouts(LM_LinkedList<listConfiguration> *queue, QueueType type)
+void LoraMesher::manageTimeout(LM_LinkedList<listConfiguration> *queue, sequencePacketConfig *configPacket)
 {
     String queueName;
-    if (type == QueueType::WRP)
+    if (configPacket->queueType == QueueType::WRP)
     {
         queueName = F("Waiting Received Queue");
     }
@@ -1658,69 +2487,101 @@ void LoraMesher::managerTimeouts(LM_LinkedList<listConfiguration> *queue, QueueT
         queueName = F("Waiting Send Queue");
     }
 
-    SAFE_ESP_LOGV(LM_TAG, "Checking %s timeouts. Open connections %d", queueName.c_str(), queue->getLength());
-
-    queue->setInUse();
+    listConfiguration *current = nullptr;
 
     if (queue->moveToStart())
     {
         do
         {
-            listConfiguration *current = queue->getCurrent();
+            if (queue->getCurrent()->config == configPacket)
+            {
+                current = queue->getCurrent();
+                break;
+            }
+        } while (queue->next());
+    }
 
-            // Get Config packet
-            sequencePacketConfig *configPacket = current->config;
+    if (current == nullptr)
+    {
+        SAFE_ESP_LOGE(LM_TAG, "%s, timeout of a sequence not found, Seq_Id: %d", queueName.c_str(), configPacket->seq_id);
+        return;
+    }
 
-            // If Config packet has reached timeout
-            if (configPacket->timeout < millis())
-            {
-                // Increment number of timeouts
-                configPacket->numberOfTimeouts++;
-
-                // Description of the timeout:
-                // The number of the packet would be the following:
-                // If it is a sender it starts from 0 to n + 1 packets, that includes the sync packet: If num = 0, it is that the sync packet has been lost, if num > 0, it is that the packet num - 1 has been lost
-                // For the the receiver it starts from 0 to n packets
-                ESP_LOGW(LM_TAG, "%s timeout reached, Src: %X, Seq_Id: %d, Num: %d, N.TimeOuts %d",
-                         queueName.c_str(), configPacket->source, configPacket->seq_id, configPacket->lastAck + configPacket->firstAckReceived, configPacket->numberOfTimeouts);
-
-                // If number of timeouts is greater than Max timeouts, erase it
-                if (configPacket->numberOfTimeouts >= MAX_TIMEOUTS)
-                {
-                    SAFE_ESP_LOGE(LM_TAG, "%s, MAX TIMEOUTS reached, erasing Id: %d", queueName.c_str(), configPacket->seq_id);
-                    clearLinkedList(current);
-                    queue->DeleteCurrent();
-                    continue;
-                }
+    // Increment number of timeouts
+    configPacket->numberOfTimeouts++;
 
-                // Recalculate the timeout
-                recalculateTimeoutAfterTimeout(configPacket);
+    // Description of the timeout:
+    // The number of the packet would be the following:
+    // If it is a sender it starts from 0 to n + 1 packets, that includes the sync packet: If num = 0, it is that the sync packet has been lost, if num > 0, it is that the packet num - 1 has been lost
+    // For the the receiver it starts from 0 to n packets
+    ESP_LOGW(LM_TAG, "%s timeout reached, Src: %X, Seq_Id: %d, Num: %d, N.TimeOuts %d",
+             queueName.c_str(), configPacket->source, configPacket->seq_id, configPacket->lastAck + configPacket->firstAckReceived, configPacket->numberOfTimeouts);
 
-                if (type == QueueType::WRP)
-                {
-                    // Send Last ACK + 1 (Request this packet)
-                    sendLostPacket(configPacket->source, configPacket->seq_id, configPacket->lastAck + 1);
-                }
-                else
-                {
-                    // Repeat the configPacket ACK
-                    if (configPacket->firstAckReceived == 0)
-                        // Send the first packet of the sequence (SYNC packet)
-                        sendPacketSequence(current, 0);
-                }
-            }
+    // If number of timeouts is greater than Max timeouts, erase it
+    if (configPacket->numberOfTimeouts >= MAX_TIMEOUTS)
+    {
+        SAFE_ESP_LOGE(LM_TAG, "%s, MAX TIMEOUTS reached, erasing Id: %d", queueName.c_str(), configPacket->seq_id);
+        clearLinkedList(current);
+        queue->DeleteCurrent();
+        return;
+    }
 
-            vTaskDelay(1);
+    // Recalculate the timeout
+    recalculateTimeoutAfterTimeout(configPacket);
 
-        } while (queue->next());
+    if (configPacket->queueType == QueueType::WRP)
+    {
+        // Request the missing packets, Last ACK + 1 if nothing has been received after it
+        if (configPacket->hasReceivedOutOfOrder())
+            sendSackPacket(configPacket);
+        else
+            sendLostPacket(configPacket->source, configPacket->seq_id, configPacket->lastAck + 1);
     }
+    else
+    {
+        // A timeout reduces the window
+        decreaseCongestionWindow(configPacket);
 
-    queue->releaseInUse();
+        // Repeated timeouts change the route to a backup next hop
+        RoutingTableService::reportNextHopFailure(configPacket->source);
+
+        // Repeat the configPacket ACK
+        if (configPacket->firstAckReceived == 0)
+        {
+            // Send the first packet of the sequence (SYNC packet)
+            if (sendPacketSequence(current, 0))
+                incResentPackets();
+        }
+        else
+            // Send the packets that could not be sent, a stream that was not ready
+            sendSequenceWindow(current);
+    }
+}
+
+void LoraMesher::scheduleTimeout(sequencePacketConfig *configPacket)
+{
+    sequenceTimeouts->setInUse();
+
+    sequenceTimeouts->Schedule(configPacket, configPacket->timeout);
+    bool isFirst = sequenceTimeouts->First() == configPacket;
+
+    sequenceTimeouts->releaseInUse();
+
+    // The queue manager is sleeping until a later timeout
+    if (isFirst && QueueManager_TaskHandle != nullptr)
+        xTaskNotify(QueueManager_TaskHandle, 0, eSetValueWithOverwrite);
+}
+
+void LoraMesher::cancelTimeout(sequencePacketConfig *configPacket)
+{
+    sequenceTimeouts->setInUse();
+    sequenceTimeouts->Cancel(configPacket);
+    sequenceTimeouts->releaseInUse();
 }
 
 unsigned long LoraMesher::getMaximumTimeout(sequencePacketConfig *configPacket)
 {
-    uint8_t hops = configPacket->node->networkNode.metric;
+    uint8_t hops = RoutingTableService::getNumberOfHops(configPacket->source);
     if (hops == 0)
     {
         SAFE_ESP_LOGE(LM_TAG, "Find next hop in add timeout");
@@ -1736,19 +2597,20 @@ unsigned long LoraMesher::calculateTimeout(sequencePacketConfig *configPacket)
     // TODO: This timeout should be a little variable depending on the duty cycle.
     // TODO: Account for how many hops the packet needs to do
     // TODO: Account for how many packets are inside the Q_SP
-    uint8_t hops = configPacket->node->networkNode.metric;
+    unsigned long SRTT = 0, RTTVAR = 0;
+    uint8_t hops = RoutingTableService::getRouteRTT(configPacket->source, SRTT, RTTVAR);
     if (hops == 0)
     {
         SAFE_ESP_LOGE(LM_TAG, "Find next hop in add timeout");
         return MIN_TIMEOUT * 1000;
     }
 
-    if (configPacket->node->SRTT == 0)
+    if (SRTT == 0)
         // TODO: The default timeout should be enough smaller to prevent unnecessary timeouts.
         // TODO: Testing the default value
         return MIN_TIMEOUT * 1000 + hops * 5000;
 
-    unsigned long calculatedTimeout = configPacket->node->SRTT + 4 * configPacket->node->RTTVAR;
+    unsigned long calculatedTimeout = SRTT + 4UL * RTTVAR;
     unsigned long maxTimeout = getMaximumTimeout(configPacket);
 
     if (calculatedTimeout > maxTimeout)
@@ -1764,6 +2626,8 @@ void LoraMesher::addTimeout(sequencePacketConfig *configPacket)
     configPacket->timeout = millis() + timeout;
     configPacket->previousTimeout = timeout;
 
+    scheduleTimeout(configPacket);
+
     SAFE_ESP_LOGV(LM_TAG, "Timeout set to %u s", (unsigned int)(timeout / 1000));
 }
 
@@ -1791,6 +2655,8 @@ void LoraMesher::recalculateTimeoutAfterTimeout(sequencePacketConfig *configPack
     configPacket->timeout = millis() + timeout;
     configPacket->previousTimeout = timeout;
 
+    scheduleTimeout(configPacket);
+
     SAFE_ESP_LOGV(LM_TAG, "Timeout recalculated to %u s", (unsigned int)(timeout / 1000));
 }
 
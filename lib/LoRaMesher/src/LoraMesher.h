@@ -16,8 +16,18 @@
 
 #include "modules/LM_Modules.h"
 
+#include <atomic>
+
 #include "utilities/LinkedQueue.hpp"
 
+#include "utilities/RingBuffer.hpp"
+
+#include "utilities/TimerHeap.hpp"
+
+#include "utilities/DuplicateFilter.hpp"
+
+#include "utilities/SackBitmap.hpp"
+
 #include "services/PacketService.h"
 
 #include "services/RoutingTableService.h"
@@ -30,6 +40,14 @@
 
 #include "services/SimulatorService.h"
 
+#include "services/AirtimeService.h"
+
+#include "services/AggregationService.h"
+
+#include "services/FloodService.h"
+
+#include "services/TrickleService.h"
+
 #include "entities/routingTable/RouteNode.h"
 
 /**
@@ -80,11 +98,32 @@ public:
         // MAX packet size per packet in bytes. It could be changed between 13 and 255 bytes. Recommended 100 or less bytes.
         // If exceed it will be automatically separated through multiple packets
         // In bytes (226 bytes [UE max allowed with SF7 and 125khz])
-        // MAX payload size for hello packets = LM_MAX_PACKET_SIZE - 7 bytes of header
-        // MAX payload size for data packets = LM_MAX_PACKET_SIZE - 7 bytes of header - 2 bytes of via
+        // MAX payload size for hello packets = LM_MAX_PACKET_SIZE - 17 bytes of header, 7 bytes for each route
+        // MAX payload size for data packets = LM_MAX_PACKET_SIZE - 7 bytes of header - 2 bytes of via - 2 bytes of sequence number
         // MAX payload size for reliable and large packets = LM_MAX_PACKET_SIZE - 7 bytes of header - 2 bytes of via - 3 of control packet.
         // Having different max_packet_size in the same network will cause problems.
         size_t max_packet_size = LM_MAX_PACKET_SIZE;
+        // Maximum channel activity detections before giving up sending a packet because the channel is busy.
+        uint8_t maxChannelAccessAttempts = MAX_TRY_BEFORE_SEND;
+        uint8_t dutyCycle = LM_DUTY_CYCLE; // Maximum percentage of each hour that the node can be transmitting.
+        uint8_t controlAirtimeReserve = LM_CONTROL_AIRTIME_RESERVE; // Percentage of the duty cycle reserved for control packets.
+        uint32_t aggregationHoldTime = LM_AGGREGATION_HOLD_MS; // Maximum time in ms a data packet waits, while another packet is on air, to be sent together with others to the same next hop. 0 disables it.
+        uint32_t helloIntervalMin = LM_TRICKLE_IMIN_MS; // Minimum interval in ms between hello packets, used when the routing table changes.
+        uint8_t helloIntervalDoublings = LM_TRICKLE_IMAX_DOUBLINGS; // Times the hello interval doubles while the routing table does not change, up to 255 s.
+        uint8_t helloRedundancy = LM_TRICKLE_K; // Consistent hellos heard in an interval that suppress our hello. 0 disables it.
+        bool linkQualityRouting = true; // Select the routes by the expected transmissions of their links instead of the number of hops.
+        uint8_t routeHysteresis = LM_ETX_HYSTERESIS; // Cost improvement needed to change the next hop of a route, in 1/LM_ETX_SCALE transmissions.
+        size_t routingTableCapacity = RTMAXSIZE; // Maximum number of routes, reserved when the configuration is initialized.
+        route_eviction_e routeEviction = LM_ROUTE_EVICTION; // Route replaced when the routing table is full and a new route arrives.
+        // Packets of a reliable payload in flight without being acknowledged. Having different window sizes in the same network makes the receivers drop packets.
+        uint8_t reliableWindowSize = LM_RELIABLE_WINDOW_SIZE;
+        uint8_t congestionQueueThreshold = LM_CONGESTION_QUEUE_THRESHOLD; // Send queue depth from which the reliable payloads going through this node reduce their window.
+        size_t duplicateCacheSize = LM_DUPLICATE_CACHE_SIZE; // Forwarded packets remembered in each generation of the duplicate cache.
+        float duplicateCacheFalsePositiveRate = LM_DUPLICATE_CACHE_FP_RATE; // False positive rate of the duplicate cache when a generation is full.
+        uint32_t duplicateCacheTime = LM_DUPLICATE_CACHE_MS; // Time in ms of each generation of the duplicate cache. 0 disables it.
+        uint32_t floodMaxDelay = LM_FLOOD_MAX_DELAY_MS; // Maximum random delay in ms before relaying a flooded packet.
+        uint8_t floodRedundancy = LM_FLOOD_REDUNDANCY; // Copies heard before relaying a flooded packet that suppress the relay. 0 disables it.
+        uint8_t floodMaxHops = LM_FLOOD_MAX_HOPS; // Maximum hops of the flooded packets sent by this node.
 #ifdef ARDUINO
         // Custom SPI pins
         SPIClass* spi = nullptr;
@@ -260,6 +299,7 @@ public:
 
         //Create a data packet with the payload
         DataPacket* dPacket = PacketService::createDataPacket(dst, getLocalAddress(), DATA_P, reinterpret_cast<uint8_t*>(payload), payloadSizeInBytes);
+        dPacket->number = dataSequenceNumber++;
 
         //Create the packet and set it to the send queue
         setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(dPacket), DEFAULT_PRIORITY+2);
@@ -268,6 +308,7 @@ public:
     /**
      * @brief Send the payload reliable.
      * It will wait for an ACK back from the destination to send the next packet.
+     * The payload is copied once, it can be freed after calling this function.
      *
      * @param dst destination address
      * @param payload payload to send
@@ -288,6 +329,75 @@ public:
         sendReliablePacket(dst, reinterpret_cast<uint8_t*>(payload), sizeof(T) * payloadSize);
     }
 
+    /**
+     * @brief Send the payload to all the nodes of the network. Each node delivers it once and relays it
+     * after a random delay, unless it has heard enough copies of it.
+     *
+     * @param payload payload to send
+     * @param payloadSize payload size to be send in Bytes, up to the maximum payload of a FLOOD_P packet
+     */
+    void sendFloodPacket(uint8_t* payload, uint8_t payloadSize);
+
+    /**
+     * @brief Send the payload to all the nodes of the network
+     *
+     * @tparam T
+     * @param payload Payload of type T
+     * @param payloadSize Length of the payload in T
+     */
+    template <typename T>
+    void sendFlood(T* payload, uint8_t payloadSize) {
+        sendFloodPacket(reinterpret_cast<uint8_t*>(payload), sizeof(T) * payloadSize);
+    }
+
+    /**
+     * @brief Reads a part of a streamed payload. It could be called again with the same offset if a packet is lost.
+     *
+     * @param buffer Buffer where the bytes need to be copied
+     * @param offset Position of the first byte inside the payload
+     * @param size Number of bytes requested
+     * @param context Context given when sending the stream
+     * @return size_t Number of bytes copied. Less than size if they are not ready, it will be called again later
+     */
+    typedef size_t (*StreamReader)(uint8_t* buffer, uint32_t offset, size_t size, void* context);
+
+    /**
+     * @brief Receives a part of a streamed payload. The parts are delivered in order, as soon as they arrive
+     *
+     * @param src Source address
+     * @param seq_id Sequence Id of the stream
+     * @param offset Position of the first byte inside the payload
+     * @param data Bytes received, only valid during the call
+     * @param size Number of bytes received
+     * @param last If it is the last part of the payload
+     * @param context Context given when setting the stream receiver
+     */
+    typedef void (*StreamReceiver)(uint16_t src, uint8_t seq_id, uint32_t offset, uint8_t* data, size_t size, bool last, void* context);
+
+    /**
+     * @brief Send a payload reliable without having it in memory. The packets are read with the reader when
+     * they are sent, only the packets of the window are in memory.
+     * If the destination has a stream receiver, it receives the payload in parts as they arrive.
+     *
+     * @param dst destination address
+     * @param payloadSize payload size to be send in Bytes
+     * @param reader Function that reads the parts of the payload, it needs to be valid until the payload is sent
+     * @param context Context passed to the reader
+     */
+    void sendReliableStream(uint16_t dst, uint32_t payloadSize, StreamReader reader, void* context = nullptr);
+
+    /**
+     * @brief Set the function that receives the streamed payloads. If it is not set,
+     * the streamed payloads are received joined as the other reliable payloads.
+     *
+     * @param receiver Function that receives the parts of the payloads, nullptr to disable it
+     * @param context Context passed to the receiver
+     */
+    void setStreamReceiver(StreamReceiver receiver, void* context = nullptr) {
+        streamReceiverContext = context;
+        streamReceiver = receiver;
+    }
+
     /**
      * @brief Returns the number of packets inside the received packets queue
      *
@@ -302,6 +412,20 @@ public:
      */
     size_t getSendQueueSize();
 
+    /**
+     * @brief Get the maximum number of packets that have been waiting to be sent at the same time
+     *
+     * @return size_t Send Queue Peak Size
+     */
+    size_t getSendQueuePeakSize();
+
+    /**
+     * @brief Get the number of packets dropped because the send queue was full
+     *
+     * @return uint32_t
+     */
+    uint32_t getSendQueueOverflowsNum();
+
     /**
       * @brief Get the Next Application Packet
       *
@@ -324,7 +448,7 @@ public:
      */
     template <typename T>
     static void deletePacket(AppPacket<T>* p) {
-        vPortFree(p);
+        MemoryPoolService::freePacket(p);
     }
 
     /**
@@ -370,6 +494,99 @@ public:
      */
     uint32_t getSentHelloPacketsNum() { return sentHelloPacketsNum; }
 
+    /**
+     * @brief Get the Sent Full Hello Packets Num, hellos that contained the whole routing table
+     *
+     * @return uint32_t
+     */
+    uint32_t getSentFullHelloPacketsNum() { return sentFullHelloPacketsNum; }
+
+    /**
+     * @brief Get the number of hellos sent before their time to advertise removed routes
+     *
+     * @return uint32_t
+     */
+    uint32_t getTriggeredHelloPacketsNum() { return triggeredHelloPacketsNum; }
+
+    /**
+     * @brief Get the bytes sent in hello packets, including the full hello requests
+     *
+     * @return uint32_t
+     */
+    uint32_t getSentHelloBytes() { return sentHelloBytes; }
+
+    /**
+     * @brief Get the number of full hellos requested to the neighbors
+     *
+     * @return uint32_t
+     */
+    uint32_t getFullHelloRequestsNum() { return fullHelloRequestsNum; }
+
+    /**
+     * @brief Get the number of times a reliable payload has reduced its window, because of a lost packet
+     * or a congested node in the path
+     *
+     * @return uint32_t
+     */
+    uint32_t getCongestionEventsNum() { return congestionEventsNum; }
+
+    /**
+     * @brief Get the number of packets of reliable payloads sent again, because they were lost or timed out
+     *
+     * @return uint32_t
+     */
+    uint32_t getResentPacketsNum() { return resentPacketsNum; }
+
+    /**
+     * @brief Get the peak of bytes held by a single outgoing reliable payload, the copy of the payload
+     * and the packets of the window that have not been acknowledged
+     *
+     * @return uint32_t
+     */
+    uint32_t getReliableSendPeakBytes() { return reliableSendPeakBytes; }
+
+    /**
+     * @brief Get the number of packets not forwarded because they had already been forwarded
+     *
+     * @return uint32_t
+     */
+    uint32_t getDuplicatePacketsNum() { return duplicatePacketsNum; }
+
+    /**
+     * @brief Get the number of routes that changed to a backup next hop, because the next hop was stale or failed
+     *
+     * @return uint32_t
+     */
+    uint32_t getRouteFailoversNum() { return RoutingTableService::getFailoversNum(); }
+
+    /**
+     * @brief Get the number of routes replaced by new ones because the routing table was full
+     *
+     * @return uint32_t
+     */
+    uint32_t getEvictedRoutesNum() { return RoutingTableService::getEvictedRoutesNum(); }
+
+    /**
+     * @brief Get the bytes reserved for the routing table, for its whole capacity
+     *
+     * @return size_t
+     */
+    size_t getRoutingTableBytes() { return RoutingTableService::getMemory(); }
+
+    /**
+     * @brief Get the bytes reserved for each route of the capacity: the route node, its index slots and its share of the neighbors
+     *
+     * @return size_t
+     */
+    size_t getRouteEntryBytes() { return RoutingTableService::getMemory() / RoutingTableService::getCapacity(); }
+
+    /**
+     * @brief Get the bytes used by the duplicate cache
+     *
+     * @return size_t
+     */
+    size_t getDuplicateCacheBytes() { return duplicateFilter != nullptr ? duplicateFilter->getMemory() : 0; }
+
     /**
      * @brief Get the Received Broadcast Packets Num
      *
@@ -412,6 +629,27 @@ public:
      */
     uint32_t getReceivedNotForMe() { return receivedPacketNotForMeNum; }
 
+    /**
+     * @brief Get the number of received packets dropped because the received packets queue was full
+     *
+     * @return uint32_t
+     */
+    uint32_t getReceivedQueueOverflowsNum() { return ReceivedPackets->getOverflows(); }
+
+    /**
+     * @brief Get the maximum number of received packets that have been waiting to be processed at the same time
+     *
+     * @return size_t
+     */
+    size_t getReceivedQueuePeakSize() { return ReceivedPackets->getPeakLength(); }
+
+    /**
+     * @brief Get the number of allocations that used the heap because a memory pool was empty
+     *
+     * @return uint32_t
+     */
+    uint32_t getMemoryPoolExhaustedNum() { return MemoryPoolService::getExhaustedNum(); }
+
     /**
      * @brief Get the payload received bytes
      *
@@ -440,6 +678,83 @@ public:
      */
     uint32_t getSentControlBytes() { return sentControlBytes; }
 
+    /**
+     * @brief Get the number of times the channel was busy before sending a packet
+     *
+     * @return uint32_t
+     */
+    uint32_t getBusyChannelNum() { return busyChannelNum; }
+
+    /**
+     * @brief Get the number of packets not sent because the channel was busy in all the attempts
+     *
+     * @return uint32_t
+     */
+    uint32_t getChannelAccessFailureNum() { return channelAccessFailureNum; }
+
+    /**
+     * @brief Get the total time in ms waiting in backoff because the channel was busy
+     *
+     * @return uint32_t
+     */
+    uint32_t getBackoffTimeMs() { return backoffTimeMs; }
+
+    /**
+     * @brief Get the time on air used in the last hour in ms
+     *
+     * @return uint32_t
+     */
+    uint32_t getUsedAirtime() { return AirtimeService::getUsedAirtime(); }
+
+    /**
+     * @brief Get the remaining time on air that data packets can use in the current hour in ms
+     *
+     * @return uint32_t
+     */
+    uint32_t getRemainingDataAirtime() { return AirtimeService::getRemainingAirtime(false); }
+
+    /**
+     * @brief Get the number of packets deferred because the duty cycle budget was exhausted
+     *
+     * @return uint32_t
+     */
+    uint32_t getDeferredPacketsNum() { return deferredPacketsNum; }
+
+    /**
+     * @brief Get the number of packets dropped because the duty cycle budget was exhausted and the deferred queue was full
+     *
+     * @return uint32_t
+     */
+    uint32_t getDutyCycleDroppedNum() { return dutyCycleDroppedNum; }
+
+    /**
+     * @brief Get the number of data packets sent inside aggregated packets
+     *
+     * @return uint32_t
+     */
+    uint32_t getAggregatedPacketsNum() { return AggregationService::getAggregatedPacketsNum(); }
+
+    /**
+     * @brief Get the number of flooded packets relayed
+     *
+     * @return uint32_t
+     */
+    uint32_t getFloodRelayedPacketsNum() { return FloodService::getRelayedPacketsNum(); }
+
+    /**
+     * @brief Get the number of flooded packets not relayed because enough copies were heard
+     *
+     * @return uint32_t
+     */
+    uint32_t getFloodSuppressedPacketsNum() { return FloodService::getSuppressedPacketsNum(); }
+
+    /**
+     * @brief Get the number of duplicate flooded packets received
+     *
+     * @return uint32_t
+     */
+    uint32_t getFloodDuplicatePacketsNum() { return FloodService::getDuplicatePacketsNum(); }
+
     /**
      * @brief Defines that the node is a gateway
      *
@@ -505,9 +820,23 @@ private:
 
     LM_LinkedList<AppPacket<uint8_t>>* ReceivedAppPackets = new LM_LinkedList<AppPacket<uint8_t>>();
 
-    LM_LinkedList<QueuePacket<Packet<uint8_t>>>* ReceivedPackets = new LM_LinkedList<QueuePacket<Packet<uint8_t>>>();
+    /**
+     * @brief Received packets waiting to be processed. Only receivingRoutine pushes and only processPackets pops
+     *
+     */
+    LM_RingBuffer<QueuePacket<Packet<uint8_t>>>* ReceivedPackets = new LM_RingBuffer<QueuePacket<Packet<uint8_t>>>(LM_RECEIVED_QUEUE_SIZE);
 
-    LM_LinkedList<QueuePacket<Packet<uint8_t>>>* ToSendPackets = new LM_LinkedList<QueuePacket<Packet<uint8_t>>>();
+    /**
+     * @brief Packets waiting to be sent, ordered by priority
+     *
+     */
+    LM_PriorityQueue<QueuePacket<Packet<uint8_t>>>* ToSendPackets = new LM_PriorityQueue<QueuePacket<Packet<uint8_t>>>(LM_SEND_QUEUE_SIZE);
+
+    /**
+     * @brief Packets waiting for duty cycle budget. Only used by the sendPackets task
+     *
+     */
+    LM_LinkedList<QueuePacket<Packet<uint8_t>>>* DeferredPackets = new LM_LinkedList<QueuePacket<Packet<uint8_t>>>();
 
     /**
      * @brief RadioLib module
@@ -516,7 +845,7 @@ private:
     LM_Module* radio = nullptr;
 
     /**
-     * @brief Hello task handle. It will send a hello packet every HELLO_PACKETS_DELAY s
+     * @brief Hello task handle. It will send the hello packets when the Trickle timer decides
      *
      */
     TaskHandle_t Hello_TaskHandle = nullptr;
@@ -577,6 +906,14 @@ private:
 
     static void onReceive(void);
 
+    static void onTransmitDone(void);
+
+    /**
+     * @brief Given by onTransmitDone when the radio has finished sending a packet
+     *
+     */
+    SemaphoreHandle_t txDoneSemaphore = nullptr;
+
     void setDioActionsForScanChannel();
 
     void setDioActionsForReceivePacket();
@@ -601,6 +938,13 @@ private:
 
     void sendHelloPacket();
 
+    /**
+     * @brief Ask a neighbor to send its whole routing table
+     *
+     * @param dst Address of the neighbor
+     */
+    void sendFullHelloRequest(uint16_t dst);
+
     void routingTableManager();
 
     void queueManager();
@@ -622,6 +966,33 @@ private:
     uint32_t sentHelloPacketsNum = 0;
     void incSentHelloPackets() { sentHelloPacketsNum++; }
 
+    uint32_t sentFullHelloPacketsNum = 0;
+    void incSentFullHelloPackets() { sentFullHelloPacketsNum++; }
+
+    uint32_t triggeredHelloPacketsNum = 0;
+    void incTriggeredHelloPackets() { triggeredHelloPacketsNum++; }
+
+    uint32_t sentHelloBytes = 0;
+    void incSentHelloBytes(uint32_t bytes) { sentHelloBytes += bytes; }
+
+    uint32_t fullHelloRequestsNum = 0;
+    void incFullHelloRequests() { fullHelloRequestsNum++; }
+
+    uint32_t congestionEventsNum = 0;
+    void incCongestionEvents() { congestionEventsNum++; }
+
+    uint32_t resentPacketsNum = 0;
+    void incResentPackets() { resentPacketsNum++; }
+
+    uint32_t reliableSendPeakBytes = 0;
+    void updateReliableSendPeakBytes(uint32_t bytes) { if (bytes > reliableSendPeakBytes) reliableSendPeakBytes = bytes; }
+
+    uint32_t duplicatePacketsNum = 0;
+    void incDuplicatePackets() { duplicatePacketsNum++; }
+
+    // Sequence number of the next data packet created by this node
+    uint16_t dataSequenceNumber = 0;
+
     uint32_t receivedBroadcastPacketsNum = 0;
     void incReceivedBroadcast() { receivedBroadcastPacketsNum++; }
 
@@ -652,6 +1023,21 @@ private:
     uint32_t sentControlBytes = 0;
     void incSentControlBytes(uint32_t numBytes) { sentControlBytes += numBytes; }
 
+    uint32_t busyChannelNum = 0;
+    void incBusyChannel() { busyChannelNum++; }
+
+    uint32_t channelAccessFailureNum = 0;
+    void incChannelAccessFailure() { channelAccessFailureNum++; }
+
+    uint32_t backoffTimeMs = 0;
+    void incBackoffTime(uint32_t ms) { backoffTimeMs += ms; }
+
+    uint32_t deferredPacketsNum = 0;
+    void incDeferredPackets() { deferredPacketsNum++; }
+
+    uint32_t dutyCycleDroppedNum = 0;
+    void incDutyCycleDropped() { dutyCycleDroppedNum++; }
+
     /**
      * @brief Function that process the packets inside Received Packets
      * Task executed every time that a packet arrive.
@@ -667,7 +1053,7 @@ private:
      */
     template <typename T>
     static void deletePacket(Packet<T>* p) {
-        vPortFree(p);
+        MemoryPoolService::freePacket(p);
     }
 
     /**
@@ -697,6 +1083,13 @@ private:
      */
     void notifyNewSequenceStarted();
 
+    /**
+     * @brief Split an aggregated packet and process each one of the data packets inside it
+     *
+     * @param pq Packet queue with the aggregated packet
+     */
+    void processAggregatedPacket(QueuePacket<DataPacket>* pq);
+
     /**
      * @brief Process the data packet
      *
@@ -719,13 +1112,68 @@ private:
     void notifyUserReceivedPacket(AppPacket<uint8_t>* appPq);
 
     /**
-     * @brief Send a packet through Lora
+     * @brief Start sending a packet through Lora. It returns when the packet is on air,
+     * waitPacketSent needs to be called before sending another packet or deleting it.
      *
      * @param p Packet to send
+     * @return true the transmission has started
+     * @return false the transmission has not started
+     */
+    bool startSendPacket(Packet<uint8_t>* p);
+
+    /**
+     * @brief Wait until the packet started with startSendPacket has been sent and start receiving again
+     *
+     * @param p Packet that is being sent
      * @return true has been send correctly
      * @return false has not been send
      */
-    bool sendPacket(Packet<uint8_t>* p);
+    bool waitPacketSent(Packet<uint8_t>* p);
+
+    /**
+     * @brief Get the next packet of the send queue and resolve its next hop.
+     * Packets without route or sent through WiFi are handled and deleted here.
+     *
+     * @return QueuePacket<Packet<uint8_t>>* Packet ready to be sent or nullptr
+     */
+    QueuePacket<Packet<uint8_t>>* getNextPacketToSend();
+
+    /**
+     * @brief Get the next packet that will be sent through LoRa. Small data packets are held by the
+     * AggregationService and joined with other packets to the same next hop.
+     *
+     * @param flush Send the held packets when nothing else is queued. False while another packet is on air,
+     * so the packets queued meanwhile can join them
+     * @return QueuePacket<Packet<uint8_t>>* Packet ready to be sent or nullptr
+     */
+    QueuePacket<Packet<uint8_t>>* getNextFrameToSend(bool flush);
+
+    /**
+     * @brief Returns if the packet type can use the airtime reserved for control packets
+     *
+     * @param type Packet type
+     */
+    bool usesControlAirtime(uint8_t type);
+
+    /**
+     * @brief Move the oldest deferred packets back to the send queue while there is budget for them. They stay
+     * deferred while the send queue is full
+     *
+     */
+    void releaseDeferredPackets();
+
+    /**
+     * @brief Move the flooded packets whose relay delay has finished to the send queue
+     *
+     */
+    void releaseFloodPackets();
+
+    /**
+     * @brief Process a flooded packet. Notify the user the first time and schedule the relay
+     *
+     * @param pq Packet queue
+     */
+    void processFloodPacket(QueuePacket<ControlPacket>* pq);
 
     /**
      * @brief Proccess that sends the data inside the FIFO
@@ -744,14 +1192,15 @@ private:
 
 
     /**
-     * @brief Get the Start Sequence Packet Queue object
+     * @brief Get the Start Sequence Packet
      *
      * @param destination destination address
      * @param seq_id Sequence Id
      * @param num_packets Number of packets of the sequence
-     * @return QueuePacket<ControlPacket>*
+     * @param flags Sync packet flags
+     * @return ControlPacket*
      */
-    QueuePacket<ControlPacket>* getStartSequencePacketQueue(uint16_t destination, uint8_t seq_id, uint16_t num_packets);
+    ControlPacket* getStartSequencePacket(uint16_t destination, uint8_t seq_id, uint16_t num_packets, uint8_t flags);
 
     /**
      * @brief Sends an ACK packet to the destination
@@ -794,8 +1243,21 @@ private:
      * @param source Source Id
      * @param seq_id Sequence Id
      * @param seq_num Sequence number
+     * @param flags Sync packet flags
+     */
+    void processSyncPacket(uint16_t source, uint8_t seq_id, uint16_t seq_num, uint8_t flags);
+
+    /**
+     * @brief Function that receives the streamed payloads
+     *
+     */
+    StreamReceiver streamReceiver = nullptr;
+
+    /**
+     * @brief Context of the stream receiver
+     *
      */
-    void processSyncPacket(uint16_t source, uint8_t seq_id, uint16_t seq_num);
+    void* streamReceiverContext = nullptr;
 
     /**
      * @brief Add the ack number to the respectively sequence and reset the timeout numbers
@@ -803,33 +1265,57 @@ private:
      * @param source Source of the packet
      * @param seq_id Sequence id of the packet
      * @param seq_num Sequence number that has been Acknowledged
+     * @param queueDepth Greatest send queue depth of the nodes in the path of the ACK
      */
-    void addAck(uint16_t source, uint8_t seq_id, uint16_t seq_num);
+    void addAck(uint16_t source, uint8_t seq_id, uint16_t seq_num, uint8_t queueDepth);
 
     /**
-     * @brief Sequence Id, used to get the id of the packet sequence
+     * @brief Get the send queue depth carried by an ACK or a selective ACK, the last byte of the payload
      *
+     * @param cPacket ACK packet
+     * @return uint8_t Queue depth, 0 if the packet does not carry it
      */
-    uint8_t sequence_id = 0;
+    uint8_t getAckQueueDepth(ControlPacket* cPacket);
 
     /**
-     * @brief Get the Sequence Id for the packet sequence
+     * @brief Get the number of packets inside the send queue, saturated to 255
      *
      * @return uint8_t
      */
-    uint8_t getSequenceId();
+    uint8_t getSendQueueDepth();
 
     /**
-     * @brief Manage all the packets inside the Q_WSP, checking for timeouts and erasing them if lost connection
+     * @brief Get the role advertised in the hellos. The CLIENT and GATEWAY nodes add their uplink load in the
+     * upper nibble, from the packets waiting to be uploaded. A CLIENT without WiFi has the maximum load
      *
+     * @return uint8_t
      */
-    void managerSendQueue();
+    uint8_t getAdvertisedRole();
 
     /**
-     * @brief Manage all the packets inside the Q_WRP, checking for timeouts and erasing them if lost connection
+     * @brief Set the send queue depth of an ACK that is being forwarded, if this node is more congested
      *
+     * @param cPacket ACK packet
      */
-    void managerReceivedQueue();
+    void updateAckQueueDepth(ControlPacket* cPacket);
+
+    /**
+     * @brief Sequence Id, used to get the id of the packet sequence
+     *
+     */
+    uint8_t sequence_id = 0;
+
+    /**
+     * @brief Get the Sequence Id for the packet sequence
+     *
+     * @return uint8_t
+     */
+    uint8_t getSequenceId();
+
+    enum QueueType {
+        WRP,
+        WSP
+    };
 
     /**
      * @brief Used to set the configuration of the sequence of packets of the lists of packets
@@ -839,6 +1325,7 @@ private:
         //Identification is Sequence Id and Source address
         uint8_t seq_id; //Sequence Id
         uint16_t source; //Source Address
+        QueueType queueType; //Queue of the sequence, Q_WRP or Q_WSP
 
         uint16_t number{0}; //Number of packets of the sequence
         uint8_t firstAckReceived{0}; //If this value is set to 0, there has not been received any ack.
@@ -847,26 +1334,153 @@ private:
         unsigned long previousTimeout{0}; //Previous timeout of the sequence
         uint8_t numberOfTimeouts{0}; //Number of timeouts that has been occurred
         unsigned long calculatingRTT{0}; // Calculating RTT
-        RouteNode* node; //Node of the routing table sequence
-
-        sequencePacketConfig(uint8_t seq_id, uint16_t source, uint16_t number, RouteNode* node): seq_id(seq_id), source(source), number(number), node(node) {};
+        size_t timerIndex{SIZE_MAX}; //Position inside the timeouts heap, SIZE_MAX if it is not scheduled
+        uint16_t lastSent{0}; //Last packet of the sequence sent. Only for sent sequences
+        uint16_t rttNumber{0}; //Packet used to calculate the RTT, 0 if none. Only for sent sequences
+        uint16_t lostRequested{0}; //Last packet requested with a lost packet. Only for received sequences
+        uint8_t congestionWindow{1}; //Packets that can be in flight. Only for sent sequences
+        uint8_t slowStartThreshold{0}; //Window until it grows exponentially. Only for sent sequences
+        uint8_t ackedInWindow{0}; //Packets acknowledged since the window last grew. Only for sent sequences
+        uint16_t recoveryNumber{0}; //Last packet sent when the window was reduced, not reduced again until it is acknowledged. Only for sent sequences
+        uint8_t* receivedBitmap{nullptr}; //Bit i set if the packet lastAck + 1 + i has been received. Only for received sequences
+        uint8_t receivedBitmapSize{0}; //Size in bytes of the received bitmap
+
+        sequencePacketConfig(uint8_t seq_id, uint16_t source, QueueType queueType, uint16_t number): seq_id(seq_id), source(source), queueType(queueType), number(number) {};
+
+        ~sequencePacketConfig() { delete[] receivedBitmap; }
+
+        /**
+         * @brief Mark a packet after lastAck as received
+         *
+         * @param seq_num Number of the packet
+         */
+        void setReceived(uint16_t seq_num) {
+            if (seq_num > lastAck)
+                LM_SackBitmap::Set(receivedBitmap, receivedBitmapSize, seq_num - lastAck - 1);
+        }
+
+        /**
+         * @brief Returns if a packet after lastAck has been received
+         *
+         * @param seq_num Number of the packet
+         */
+        bool isReceived(uint16_t seq_num) {
+            return seq_num > lastAck && LM_SackBitmap::Get(receivedBitmap, receivedBitmapSize, seq_num - lastAck - 1);
+        }
+
+        /**
+         * @brief Increment lastAck and move the received bitmap
+         *
+         */
+        void incrementLastAck() {
+            lastAck++;
+            LM_SackBitmap::Shift(receivedBitmap, receivedBitmapSize);
+        }
+
+        /**
+         * @brief Returns if there are packets received after a missing one
+         *
+         */
+        bool hasReceivedOutOfOrder() {
+            return LM_SackBitmap::Any(receivedBitmap, receivedBitmapSize);
+        }
     };
 
     /**
      * @brief List configuration
      *
      */
+    /**
+     * @brief Payload of the sent sequences. The packets of the sequence are created from it when they are sent.
+     * It is shared by all the sequences of a payload sent to the broadcast address
+     *
+     */
+    struct sequencePayload {
+        uint8_t* payload; //Copy of the user payload, nullptr if it is streamed
+        uint32_t payloadSize; //Size of the payload in bytes
+        std::atomic<uint16_t> references; //Sequences using this payload
+        StreamReader reader{nullptr}; //Reader of the streamed payload
+        void* context{nullptr}; //Context of the reader
+
+        sequencePayload(uint8_t* payload, uint32_t payloadSize): payloadSize(payloadSize), references(1) {
+            this->payload = new uint8_t[payloadSize];
+            memcpy(this->payload, payload, payloadSize);
+        };
+
+        sequencePayload(uint32_t payloadSize, StreamReader reader, void* context): payload(nullptr), payloadSize(payloadSize), references(1), reader(reader), context(context) {};
+
+        ~sequencePayload() { delete[] payload; }
+    };
+
+    /**
+     * @brief Add a reference to the sequence payload
+     *
+     * @param payload Sequence payload
+     * @return sequencePayload* The same sequence payload
+     */
+    sequencePayload* retainSequencePayload(sequencePayload* payload);
+
+    /**
+     * @brief Release a reference to the sequence payload, deleting it when there are no more references
+     *
+     * @param payload Sequence payload
+     */
+    void releaseSequencePayload(sequencePayload* payload);
+
+    /**
+     * @brief Send a reliable payload to a destination or to all the nodes of the routing table
+     * if it is the broadcast address. The reference of the sequence payload is released
+     *
+     * @param dst Destination address
+     * @param payload Sequence payload
+     */
+    void sendSequencePayload(uint16_t dst, sequencePayload* payload);
+
+    /**
+     * @brief Send a reliable payload to a destination
+     *
+     * @param dst Destination address
+     * @param payload Sequence payload, a new reference is added for this sequence
+     */
+    void sendReliableSequence(uint16_t dst, sequencePayload* payload);
+
     struct listConfiguration {
         sequencePacketConfig* config;
-        LM_LinkedList<QueuePacket<ControlPacket>>* list;
+        AppPacket<uint8_t>* appPacket; //Packet where the received packets are copied, allocated with the SYNC packet. Only for received sequences
+        uint8_t* reorderBuffer; //One slot for each packet of the window, packets received out of order. Only for received streams
+        uint8_t lastPacketSize; //Payload size of the last packet, if it is inside the reorder buffer. Only for received streams
+        sequencePayload* payload; //Payload from which the packets are created. Only for sent sequences
     };
 
-    enum QueueType {
-        WRP,
-        WSP
-    };
+    /**
+     * @brief Manage the sequences that reached the timeout inside the Q_WRP and Q_WSP,
+     * requesting the lost packets or erasing them if lost connection
+     *
+     * @return TickType_t Ticks until the next timeout or portMAX_DELAY if there are no sequences
+     */
+    TickType_t manageTimeouts();
+
+    /**
+     * @brief Manage a sequence that reached the timeout. The queue of the sequence needs to be in use
+     *
+     * @param queue Queue of the sequence
+     * @param configPacket Configuration of the sequence
+     */
+    void manageTimeout(LM_LinkedList<listConfiguration>* queue, sequencePacketConfig* configPacket);
+
+    /**
+     * @brief Schedule the timeout of the sequence, notifying the queue manager if it is the next one
+     *
+     * @param configPacket Configuration of the sequence
+     */
+    void scheduleTimeout(sequencePacketConfig* configPacket);
 
-    void managerTimeouts(LM_LinkedList<listConfiguration>* queue, QueueType type);
+    /**
+     * @brief Remove the timeout of the sequence
+     *
+     * @param configPacket Configuration of the sequence
+     */
+    void cancelTimeout(sequencePacketConfig* configPacket);
 
     /**
      * @brief Actualize the RTT field
@@ -886,6 +1500,22 @@ private:
      */
     void processLostPacket(uint16_t destination, uint8_t seq_id, uint16_t seq_num);
 
+    /**
+     * @brief Send a selective ACK with the last packet received in order and the bitmap of the packets
+     * received after it, so the sender can send again all the missing packets at once
+     *
+     * @param config Configuration of the received sequence
+     */
+    void sendSackPacket(sequencePacketConfig* config);
+
+    /**
+     * @brief Process a selective ACK, acknowledge the packets until the base number and send again the missing ones
+     *
+     * @param source Source of the selective ACK
+     * @param cPacket Selective ACK packet
+     */
+    void processSackPacket(uint16_t source, ControlPacket* cPacket);
+
     /**
      * @brief Send a packet of the sequence of the specific list configuration and sequence_num
      *
@@ -897,9 +1527,66 @@ private:
     bool sendPacketSequence(listConfiguration* lstConfig, uint16_t seq_num);
 
     /**
-     * @brief Join all the packets inside the list configuration and notify the user
+     * @brief Send the packets of the sequence that fit inside the window and have not been sent yet
      *
-     * @param listConfig list configuration to join
+     * @param lstConfig List configuration
+     */
+    void sendSequenceWindow(listConfiguration* lstConfig);
+
+    /**
+     * @brief Get the maximum window size of the reliable payloads
+     *
+     * @return uint8_t
+     */
+    uint8_t getMaxWindowSize() { return loraMesherConfig->reliableWindowSize == 0 ? 1 : loraMesherConfig->reliableWindowSize; }
+
+    /**
+     * @brief Grow the congestion window after new packets have been acknowledged. Exponentially until
+     * the slow start threshold and one packet each window afterwards
+     *
+     * @param config Configuration of the sent sequence
+     * @param acked Number of packets acknowledged
+     */
+    void increaseCongestionWindow(sequencePacketConfig* config, uint16_t acked);
+
+    /**
+     * @brief Halve the congestion window, at most once for each window of packets sent
+     *
+     * @param config Configuration of the sent sequence
+     */
+    void decreaseCongestionWindow(sequencePacketConfig* config);
+
+    /**
+     * @brief Copy the payload of a received packet into its position of the app packet
+     *
+     * @param lstConfig List configuration
+     * @param cPacket Packet received
+     * @return true If the payload has been copied
+     * @return false If the packet does not fit inside the app packet
+     */
+    bool copyLargePayloadPacket(listConfiguration* lstConfig, ControlPacket* cPacket);
+
+    /**
+     * @brief Deliver a part of a streamed payload to the stream receiver
+     *
+     * @param lstConfig List configuration
+     * @param seq_num Number of the packet
+     * @param data Payload of the packet
+     * @param size Size of the payload
+     */
+    void deliverStreamPacket(listConfiguration* lstConfig, uint16_t seq_num, uint8_t* data, size_t size);
+
+    /**
+     * @brief Deliver the packets of a streamed payload received out of order that are after the last ack
+     *
+     * @param lstConfig List configuration
+     */
+    void deliverStreamReorderBuffer(listConfiguration* lstConfig);
+
+    /**
+     * @brief Notify the user with the app packet of the list configuration, all the packets have been received
+     *
+     * @param listConfig list configuration
      */
     void joinPacketsAndNotifyUser(listConfiguration* listConfig);
 
@@ -989,43 +1676,53 @@ private:
     LM_LinkedList<listConfiguration>* q_WRP = new LM_LinkedList<listConfiguration>();
 
     /**
-     * @brief Max time on air for a given configuration in ms
+     * @brief Timeouts of the sequences inside the Q_WSP and Q_WRP, ordered by deadline.
+     * The queue manager sleeps until the first one. It grows if needed
      *
      */
-    uint32_t maxTimeOnAir = 0;
+    LM_TimerHeap<sequencePacketConfig>* sequenceTimeouts = new LM_TimerHeap<sequencePacketConfig>(8);
 
     /**
-     * @brief Wait before sending function
+     * @brief Fingerprints of the data packets forwarded recently. Only used by the process packets task
      *
-     * @param repeatedDetectPreambles Number of repeated detected preambles
      */
-    void waitBeforeSend(uint8_t repeatedDetectPreambles);
+    LM_DuplicateFilter* duplicateFilter = nullptr;
 
     /**
-     * @brief Max propagation time for a given configuration in ms
-     * @return uint32_t Max propagation time
+     * @brief Returns if the packet has already been forwarded recently, and remembers it
+     *
+     * @param p Packet
+     * @return true If it is a duplicate
+     * @return false If it is new or the duplicate cache is disabled
      */
-    uint32_t getMaxPropagationTime();
+    bool isDuplicatePacket(Packet<uint8_t>* p);
 
     /**
-     * @brief Get the Propagation Time With Random ms
-     * @param multiplayer Multiplayer of the random
+     * @brief Max time on air for a given configuration in ms
      *
-     * @return uint32_t Propagation time with random
      */
-    uint32_t getPropagationTimeWithRandom(uint8_t multiplayer);
+    uint32_t maxTimeOnAir = 0;
 
     /**
-     * @brief Max Time on air for a given configuration, Used for time slots
+     * @brief Listen before talk. Checks the channel with a channel activity detection and,
+     * if it is busy, waits a binary exponential backoff before checking it again.
      *
+     * @return true The channel is free
+     * @return false The channel has been busy in all the attempts
      */
-    void recalculateMaxTimeOnAir();
+    bool waitChannelFree();
 
     /**
-     * @brief Has received a Message when scanning channels
+     * @brief Max propagation time for a given configuration in ms
+     * @return uint32_t Max propagation time
+     */
+    uint32_t getMaxPropagationTime();
+
+    /**
+     * @brief Max Time on air for a given configuration, Used for time slots
      *
      */
-    bool hasReceivedMessage = false;
+    void recalculateMaxTimeOnAir();
 
     /** @brief Get the Simulator Service object
      *
@@ -1096,7 +1793,7 @@ public:
      * @return true
      * @return false
      */
-    bool hasActiveConnections() { return hasActiveReceivedConnections() || hasActiveSentConnections() || ToSendPackets->getLength() > 0 || ReceivedPackets->getLength() > 0; };
+    bool hasActiveConnections() { return hasActiveReceivedConnections() || hasActiveSentConnections() || ToSendPackets->getLength() > 0 || DeferredPackets->getLength() > 0 || ReceivedPackets->getLength() > 0; };
 
     /**
      * @brief Returns the number of packets inside the waiting send packets queue
@@ -0,0 +1,21 @@
+#ifndef _LORAMESHER_AGGREGATED_RECORD_H
+#define _LORAMESHER_AGGREGATED_RECORD_H
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Each one of the data packets inside the payload of an AGG_DATA_P packet
+ *
+ */
+#pragma pack(1)
+class AggregatedRecord {
+public:
+    uint16_t dst;
+    uint16_t src;
+    uint16_t number;
+    uint8_t payloadSize;
+    uint8_t payload[];
+};
+#pragma pack()
+
+#endif
@@ -2,6 +2,7 @@
 #define _LORAMESHER_APPPACKET_H
 
 #include "BuildOptions.h"
+#include "services/MemoryPoolService.h"
 #include "LogManager.h"
 
 /**
@@ -52,7 +53,7 @@ public:
      */
     void operator delete(void* p) {
         SAFE_ESP_LOGV(LM_TAG, "Deleting app packet");
-        vPortFree(p);
+        MemoryPoolService::freePacket(p);
     }
 };
 
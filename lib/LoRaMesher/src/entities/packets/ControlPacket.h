@@ -4,6 +4,11 @@
 #include "RouteDataPacket.h"
 
 #include "BuildOptions.h"
+#include "services/MemoryPoolService.h"
+
+// Sync packet flags, first byte of the payload of the SYNC packet
+// The payload is delivered to the user in parts as they arrive, instead of joined
+#define SYNC_STREAM_F   0b00000001
 
 #pragma pack(1)
 class ControlPacket final: public RouteDataPacket {
@@ -28,7 +33,7 @@ public:
      */
     void operator delete(void* p) {
         ESP_LOGV(LM_TAG, "Deleting Control packet");
-        vPortFree(p);
+        MemoryPoolService::freePacket(p);
     }
 };
 #pragma pack()
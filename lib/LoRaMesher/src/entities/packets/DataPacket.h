@@ -4,10 +4,17 @@
 #include "RouteDataPacket.h"
 #include "LogManager.h"
 #include "BuildOptions.h"
+#include "services/MemoryPoolService.h"
 
 #pragma pack(1)
 class DataPacket final: public RouteDataPacket {
 public:
+    /**
+     * @brief Sequence number given by the source. Identical payloads sent by the same source are different packets
+     *
+     */
+    uint16_t number = 0;
+
     uint8_t payload[];
 
     /**
@@ -17,7 +24,7 @@ public:
      */
     void operator delete(void* p) {
         SAFE_ESP_LOGV(LM_TAG, "Deleting Data packet");
-        vPortFree(p);
+        MemoryPoolService::freePacket(p);
     }
 };
 #pragma pack()
@@ -2,6 +2,7 @@
 #define _LORAMESHER_PACKET_H
 
 #include "BuildOptions.h"
+#include "services/MemoryPoolService.h"
 #include "PacketHeader.h"
 #include "LogManager.h"
 
@@ -19,7 +20,7 @@ public:
      */
     void operator delete(void* p) {
         SAFE_ESP_LOGV(LM_TAG, "Deleting  packet");
-        vPortFree(p);
+        MemoryPoolService::freePacket(p);
     }
 
 };
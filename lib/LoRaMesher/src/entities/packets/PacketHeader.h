@@ -2,6 +2,7 @@
 #define _LORAMESHER_PACKET_HEADER_H
 
 #include "BuildOptions.h"
+#include "services/MemoryPoolService.h"
 
 #pragma pack(1)
 class PacketHeader {
@@ -18,7 +19,7 @@ public:
      */
     void operator delete(void* p) {
         ESP_LOGV(LM_TAG, "Deleting Header packet");
-        vPortFree(p);
+        MemoryPoolService::freePacket(p);
     }
 
 };
@@ -3,6 +3,8 @@
 
 #include "BuildOptions.h"
 
+#include "services/MemoryPoolService.h"
+
 template <typename T>
 class QueuePacket {
 public:
@@ -11,6 +13,14 @@ public:
     float rssi = 0;
     float snr = 0;
     T* packet;
+
+    void* operator new(size_t size) {
+        return MemoryPoolService::allocateQueuePacket(size);
+    }
+
+    void operator delete(void* p) {
+        MemoryPoolService::freeQueuePacket(p);
+    }
 };
 
 #endif
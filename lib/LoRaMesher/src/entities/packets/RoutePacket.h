@@ -4,6 +4,12 @@
 #include "PacketHeader.h"
 #include "entities/routingTable/NetworkNode.h"
 
+// Route packet flags
+// The packet contains the whole routing table instead of the changes since baseVersion
+#define HELLO_FULL_F            0b00000001
+// The sender asks the destination of the packet to send its whole routing table
+#define HELLO_REQUEST_FULL_F    0b00000010
+
 #pragma pack(1)
 class RoutePacket final: public PacketHeader {
 public:
@@ -14,6 +20,55 @@ public:
      */
     uint8_t nodeRole = 0;
 
+    /**
+     * @brief Route packet flags, HELLO_FULL_F and HELLO_REQUEST_FULL_F
+     *
+     */
+    uint8_t flags = 0;
+
+    /**
+     * @brief Index of this packet inside the hello, a hello can be split into multiple packets
+     *
+     */
+    uint8_t fragment = 0;
+
+    /**
+     * @brief Number of packets of the hello
+     *
+     */
+    uint8_t fragments = 1;
+
+    /**
+     * @brief Routing table version of the sender the changes are based on. Not used in full hellos
+     *
+     */
+    uint16_t baseVersion = 0;
+
+    /**
+     * @brief Routing table version of the sender after applying this hello
+     *
+     */
+    uint16_t version = 0;
+
+    /**
+     * @brief Digest of the whole routing table of the sender at version
+     *
+     */
+    uint16_t digest = 0;
+
+    /**
+     * @brief Hello interval of the sender in seconds. The routes via the sender expire after LM_ROUTE_TIMEOUT_INTERVALS intervals
+     *
+     */
+    uint8_t helloInterval = 0;
+
+    /**
+     * @brief Number of the hello, incremented for each hello sent. The hellos suppressed by Trickle are not numbered,
+     * so the receivers only count as lost the hellos that were sent
+     *
+     */
+    uint16_t helloSequence = 0;
+
     /**
      * @brief Network nodes
      *
@@ -0,0 +1,113 @@
+#ifndef _LORAMESHER_NEIGHBOR_NODE_H
+#define _LORAMESHER_NEIGHBOR_NODE_H
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Neighbor Node, the state of the link with a node at 1 hop and of the hellos received from it
+ *
+ */
+class NeighborNode {
+public:
+    /**
+     * @brief Address, 0 if the entry is free
+     *
+     */
+    uint16_t address = 0;
+
+    /**
+     * @brief Time in ms when the neighbor expires if no hello is received
+     *
+     */
+    uint32_t timeout = 0;
+
+    /**
+     * @brief SNR from received packets
+     *
+     */
+    int8_t receivedSNR = 0;
+
+    /**
+     * @brief SNR from sent packets
+     *
+     */
+    int8_t sentSNR = 0;
+
+    /**
+     * @brief Ratio of the hellos received from this node, 255 is all of them
+     *
+     */
+    uint8_t helloReceptionRatio = UINT8_MAX;
+
+    /**
+     * @brief Hello interval of this node in seconds, 0 if unknown
+     *
+     */
+    uint8_t helloInterval = 0;
+
+    /**
+     * @brief Cost of the link with this node, in 1/LM_ETX_SCALE expected transmissions
+     *
+     */
+    uint8_t linkCost = 0;
+
+    /**
+     * @brief Last time a hello was received from this node, in ms
+     *
+     */
+    uint32_t lastHelloTime = 0;
+
+    /**
+     * @brief Number of the last hello received from this node
+     *
+     */
+    uint16_t lastHelloSequence = 0;
+
+    /**
+     * @brief Routing table version of this neighbor we are synchronized with
+     *
+     */
+    uint16_t helloVersion = 0;
+
+    /**
+     * @brief Digest of the routing table of this neighbor at helloVersion
+     *
+     */
+    uint16_t helloDigest = 0;
+
+    /**
+     * @brief Version of the hello that is being received in multiple packets
+     *
+     */
+    uint16_t pendingHelloVersion = 0;
+
+    /**
+     * @brief Number of packets received of the pending hello
+     *
+     */
+    uint8_t pendingHelloFragments = 0;
+
+    /**
+     * @brief The routing table of this neighbor is synchronized
+     *
+     */
+    bool helloSynchronized = false;
+
+    /**
+     * @brief Identifier given to the full hello that is being received from this neighbor
+     *
+     */
+    uint16_t receivingFullHelloId = 0;
+
+    /**
+     * @brief Last time we asked this neighbor for a full hello, in ms
+     *
+     */
+    uint32_t fullHelloRequestTime = 0;
+
+    NeighborNode() {};
+
+    NeighborNode(uint16_t address_): address(address_) {};
+};
+
+#endif
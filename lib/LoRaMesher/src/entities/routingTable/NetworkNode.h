@@ -27,9 +27,22 @@ public:
      */
     uint8_t role = 0;
 
+    /**
+     * @brief Cost to reach the previous address, sum of the expected transmissions of each link in 1/LM_ETX_SCALE units
+     *
+     */
+    uint8_t cost = 0;
+
+    /**
+     * @brief Next hop used to reach the address. In the hellos, the next hop of the sender, a node does not
+     * use the routes that go through itself (split horizon with poisoned reverse)
+     *
+     */
+    uint16_t via = 0;
+
     NetworkNode() {};
 
-    NetworkNode(uint16_t address_, uint8_t metric_, uint8_t role_): address(address_), metric(metric_), role(role_) {};
+    NetworkNode(uint16_t address_, uint8_t metric_, uint8_t role_, uint8_t cost_ = 0): address(address_), metric(metric_), role(role_), cost(cost_) {};
 };
 
 #pragma pack()
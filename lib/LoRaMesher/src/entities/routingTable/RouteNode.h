@@ -1,16 +1,32 @@
 #ifndef _LORAMESHER_ROUTE_NODE_H
 #define _LORAMESHER_ROUTE_NODE_H
 
+#include "BuildOptions.h"
+
 #include "NetworkNode.h"
 
+#pragma pack(1)
+
+/**
+ * @brief Alternative next hop of a route
+ *
+ */
+struct BackupVia {
+    uint16_t via;
+    uint8_t metric;
+    uint8_t cost;
+    uint32_t timeout;
+};
+
 /**
- * @brief Route Node
+ * @brief Route Node. It is packed and it only contains the state of the route, the state of the link
+ * with the neighbors is inside NeighborNode
  *
  */
 class RouteNode {
 public:
     /**
-     * @brief Network node
+     * @brief Network node, including the next hop to send the message
      *
      */
     NetworkNode networkNode;
@@ -22,43 +38,69 @@ public:
     uint32_t timeout = 0;
 
     /**
-     * @brief Next hop to send the message
+     * @brief Alternative next hops, the best one first
+     *
+     */
+    BackupVia backupVias[LM_BACKUP_VIAS];
+
+    /**
+     * @brief Number of alternative next hops
+     *
+     */
+    uint8_t backupViasNum = 0;
+
+    /**
+     * @brief Reliable payloads timed out through the actual next hop
      *
      */
-    uint16_t via = 0;
+    uint8_t viaFailures = 0;
 
     /**
-     * @brief SNR from received packets. Only available nodes at 1 hop.
+     * @brief SRTT, smoothed round-trip time (RFC 6298), in LM_RTT_UNIT_MS units
      *
      */
-    int8_t receivedSNR = 0;
+    uint16_t SRTT = 0;
 
     /**
-     * @brief SNR from sent packets. Only available nodes at 1 hop.
+     * @brief RTTVAR, round-trip time variation (RFC 6298), in LM_RTT_UNIT_MS units
      *
      */
-    int8_t sentSNR = 0;
+    uint16_t RTTVAR = 0;
 
     /**
-     * @brief SRTT, smoothed round-trip time (RFC 6298)
+     * @brief Routing table version when this entry was changed for the last time
      *
      */
-    unsigned long SRTT = 0;
+    uint16_t version = 0;
 
     /**
-     * @brief RTTVAR, round-trip time variation (RFC 6298)
+     * @brief Full hello that advertised this entry for the last time. Used to find the entries
+     * that the next hop does not have anymore.
      *
      */
-    unsigned long RTTVAR = 0;
+    uint16_t fullHelloId = 0;
+
+    /**
+     * @brief Last time this route was used to send, in ms, 0 if it has never been used. Used to choose the route
+     * to be replaced
+     *
+     */
+    uint32_t lastUsed = 0;
 
     /**
      * @brief Construct a new Route Node object
      *
      * @param address_ Address
      * @param metric_ Metric
+     * @param role_ Role
      * @param via_ Via
+     * @param cost_ Cost
      */
-    RouteNode(uint16_t address_, uint8_t metric_, uint8_t role_, uint16_t via_): networkNode(address_, metric_, role_), via(via_) {};
+    RouteNode(uint16_t address_, uint8_t metric_, uint8_t role_, uint16_t via_, uint8_t cost_ = 0): networkNode(address_, metric_, role_, cost_) {
+        networkNode.via = via_;
+    };
 };
 
-#endif
\ No newline at end of file
+#pragma pack()
+
+#endif
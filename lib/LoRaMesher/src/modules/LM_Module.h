@@ -22,12 +22,15 @@ public:
     virtual float getSNR() = 0;
     virtual int16_t readData(uint8_t* buffer, size_t numBytes) = 0;
     virtual int16_t transmit(uint8_t* buffer, size_t length) = 0;
+    virtual int16_t startTransmit(uint8_t* buffer, size_t length) = 0;
+    virtual int16_t finishTransmit() = 0;
     virtual uint32_t getTimeOnAir(size_t length) = 0;
 
     virtual void setDioActionForReceiving(void (*action)()) = 0;
     virtual void setDioActionForReceivingTimeout(void (*action)()) = 0;
     virtual void setDioActionForScanning(void (*action)()) = 0;
     virtual void setDioActionForScanningTimeout(void (*action)()) = 0;
+    virtual void setDioActionForTransmitting(void (*action)()) = 0;
     virtual void clearDioActions() = 0;
 
     virtual int16_t setFrequency(float freq) = 0;
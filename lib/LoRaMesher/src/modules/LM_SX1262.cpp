@@ -72,6 +72,14 @@ int16_t LM_SX1262::transmit(uint8_t* buffer, size_t length) {
     return module->transmit(buffer, length);
 }
 
+int16_t LM_SX1262::startTransmit(uint8_t* buffer, size_t length) {
+    return module->startTransmit(buffer, length);
+}
+
+int16_t LM_SX1262::finishTransmit() {
+    return module->finishTransmit();
+}
+
 uint32_t LM_SX1262::getTimeOnAir(size_t length) {
     return module->getTimeOnAir(length);
 }
@@ -92,6 +100,10 @@ void LM_SX1262::setDioActionForScanningTimeout(void(*action)()) {
     return;
 }
 
+void LM_SX1262::setDioActionForTransmitting(void (*action)()) {
+    module->setDio1Action(action);
+}
+
 void LM_SX1262::clearDioActions() {
     module->clearDio1Action();
 }
@@ -0,0 +1,193 @@
+#include "AggregationService.h"
+
+void AggregationService::init(uint32_t holdTime) {
+    AggregationService::holdTime = holdTime;
+}
+
+bool AggregationService::add(QueuePacket<Packet<uint8_t>>* qp) {
+    if (holdTime == 0 || !PacketService::isOnlyDataPacket(qp->packet->type))
+        return false;
+
+    DataPacket* p = reinterpret_cast<DataPacket*>(qp->packet);
+    size_t recordSize = sizeof(AggregatedRecord) + PacketService::getPacketPayloadLength(qp->packet);
+    size_t maxPacketSize = PacketFactory::getMaxPacketSize();
+
+    if (sizeof(DataPacket) + recordSize > maxPacketSize)
+        return false;
+
+    AggregationBuffer* buffer = nullptr;
+    AggregationBuffer* oldest = nullptr;
+
+    for (size_t i = 0; i < LM_AGGREGATION_BUFFERS; i++) {
+        AggregationBuffer& current = buffers[i];
+
+        if (current.count == 0) {
+            if (buffer == nullptr)
+                buffer = &current;
+            continue;
+        }
+
+        if (current.via == p->via) {
+            // Full, send it and start a new one
+            if (current.count == LM_AGGREGATION_MAX_PACKETS || sizeof(DataPacket) + current.recordsSize + recordSize > maxPacketSize)
+                readyPackets->Append(buildPacket(current));
+
+            buffer = &current;
+            break;
+        }
+
+        if (oldest == nullptr || (int32_t) (current.startTime - oldest->startTime) < 0)
+            oldest = &current;
+    }
+
+    // All the buffers are in use, send the oldest one
+    if (buffer == nullptr) {
+        readyPackets->Append(buildPacket(*oldest));
+        buffer = oldest;
+    }
+
+    if (buffer->count == 0) {
+        buffer->via = p->via;
+        buffer->priority = 0;
+        buffer->recordsSize = 0;
+        buffer->startTime = millis();
+    }
+
+    buffer->packets[buffer->count++] = qp;
+    buffer->recordsSize += recordSize;
+    if (qp->priority > buffer->priority)
+        buffer->priority = qp->priority;
+
+    SAFE_ESP_LOGV("AggregationService", "Packet to %X via %X held, %d packets in the buffer", p->dst, p->via, buffer->count);
+
+    return true;
+}
+
+bool AggregationService::isExpired(AggregationBuffer& buffer) {
+    return buffer.count > 0 && millis() - buffer.startTime >= holdTime;
+}
+
+QueuePacket<Packet<uint8_t>>* AggregationService::popReady() {
+    if (readyPackets->getLength() > 0)
+        return readyPackets->Pop();
+
+    for (size_t i = 0; i < LM_AGGREGATION_BUFFERS; i++) {
+        if (isExpired(buffers[i]))
+            return buildPacket(buffers[i]);
+    }
+
+    return nullptr;
+}
+
+QueuePacket<Packet<uint8_t>>* AggregationService::popPending() {
+    QueuePacket<Packet<uint8_t>>* qp = popReady();
+    if (qp != nullptr)
+        return qp;
+
+    AggregationBuffer* oldest = nullptr;
+
+    for (size_t i = 0; i < LM_AGGREGATION_BUFFERS; i++) {
+        if (buffers[i].count > 0 && (oldest == nullptr || (int32_t) (buffers[i].startTime - oldest->startTime) < 0))
+            oldest = &buffers[i];
+    }
+
+    return oldest != nullptr ? buildPacket(*oldest) : nullptr;
+}
+
+bool AggregationService::hasReady() {
+    if (readyPackets->getLength() > 0)
+        return true;
+
+    for (size_t i = 0; i < LM_AGGREGATION_BUFFERS; i++) {
+        if (isExpired(buffers[i]))
+            return true;
+    }
+
+    return false;
+}
+
+bool AggregationService::hasPending() {
+    for (size_t i = 0; i < LM_AGGREGATION_BUFFERS; i++) {
+        if (buffers[i].count > 0)
+            return true;
+    }
+
+    return readyPackets->getLength() > 0;
+}
+
+uint32_t AggregationService::getTimeUntilNextFlush() {
+    uint32_t minTime = UINT32_MAX;
+    uint32_t now = millis();
+
+    for (size_t i = 0; i < LM_AGGREGATION_BUFFERS; i++) {
+        if (buffers[i].count == 0)
+            continue;
+
+        uint32_t elapsed = now - buffers[i].startTime;
+        uint32_t remaining = elapsed >= holdTime ? 0 : holdTime - elapsed;
+        if (remaining < minTime)
+            minTime = remaining;
+    }
+
+    return minTime;
+}
+
+QueuePacket<Packet<uint8_t>>* AggregationService::buildPacket(AggregationBuffer& buffer) {
+    uint8_t count = buffer.count;
+    buffer.count = 0;
+
+    // Only one packet, send it as it is
+    if (count == 1)
+        return buffer.packets[0];
+
+    DataPacket* aggPacket = PacketFactory::createPacket<DataPacket>(nullptr, buffer.recordsSize);
+    aggPacket->dst = buffer.via;
+    aggPacket->src = WiFiService::getLocalAddress();
+    aggPacket->type = AGG_DATA_P;
+    aggPacket->packetSize = sizeof(DataPacket) + buffer.recordsSize;
+    aggPacket->via = buffer.via;
+
+    size_t offset = 0;
+
+    for (uint8_t i = 0; i < count; i++) {
+        DataPacket* p = reinterpret_cast<DataPacket*>(buffer.packets[i]->packet);
+        size_t payloadSize = PacketService::getPacketPayloadLength(buffer.packets[i]->packet);
+
+        AggregatedRecord* record = reinterpret_cast<AggregatedRecord*>(aggPacket->payload + offset);
+        record->dst = p->dst;
+        record->src = p->src;
+        record->number = p->number;
+        record->payloadSize = payloadSize;
+        memcpy(record->payload, p->payload, payloadSize);
+
+        offset += sizeof(AggregatedRecord) + payloadSize;
+
+        PacketQueueService::deleteQueuePacketAndPacket(buffer.packets[i]);
+    }
+
+    aggregatedPacketsNum += count;
+
+    SAFE_ESP_LOGI("AggregationService", "Aggregated %d packets via %X in %d bytes", count, buffer.via, aggPacket->packetSize);
+
+    return PacketQueueService::createQueuePacket(reinterpret_cast<Packet<uint8_t>*>(aggPacket), buffer.priority);
+}
+
+void AggregationService::clear() {
+    while (readyPackets->getLength() > 0)
+        PacketQueueService::deleteQueuePacketAndPacket(readyPackets->Pop());
+
+    for (size_t i = 0; i < LM_AGGREGATION_BUFFERS; i++) {
+        for (uint8_t j = 0; j < buffers[i].count; j++)
+            PacketQueueService::deleteQueuePacketAndPacket(buffers[i].packets[j]);
+
+        buffers[i].count = 0;
+    }
+}
+
+AggregationService::AggregationBuffer AggregationService::buffers[LM_AGGREGATION_BUFFERS] = {};
+
+LM_LinkedList<QueuePacket<Packet<uint8_t>>>* AggregationService::readyPackets = new LM_LinkedList<QueuePacket<Packet<uint8_t>>>();
+
+uint32_t AggregationService::holdTime = LM_AGGREGATION_HOLD_MS;
+
+uint32_t AggregationService::aggregatedPacketsNum = 0;
@@ -0,0 +1,118 @@
+#ifndef _LORAMESHER_AGGREGATION_SERVICE_H
+#define _LORAMESHER_AGGREGATION_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include "entities/packets/AggregatedRecord.h"
+
+#include "entities/packets/QueuePacket.h"
+
+#include "services/PacketService.h"
+
+#include "services/PacketQueueService.h"
+
+#include "services/WiFiService.h"
+
+#include "utilities/LinkedQueue.hpp"
+
+/**
+ * @brief Aggregation Service. Holds the small data packets that go to the same next hop
+ * and joins them in a single AGG_DATA_P packet, up to the max packet size.
+ * Only used by the send task, it is not thread safe.
+ *
+ */
+class AggregationService {
+public:
+    /**
+     * @brief Initialize the Aggregation Service
+     *
+     * @param holdTime Maximum time in ms that a packet waits to be aggregated, 0 disables the aggregation
+     */
+    static void init(uint32_t holdTime);
+
+    /**
+     * @brief Add a packet, with the via already set, to be aggregated
+     *
+     * @param qp Queue packet
+     * @return true The packet is held by the service
+     * @return false The packet can not be aggregated, it needs to be sent as it is
+     */
+    static bool add(QueuePacket<Packet<uint8_t>>* qp);
+
+    /**
+     * @brief Get the next packet that needs to be sent, a full buffer or a buffer that reached the hold time
+     *
+     * @return QueuePacket<Packet<uint8_t>>* The packet ready to be sent or nullptr
+     */
+    static QueuePacket<Packet<uint8_t>>* popReady();
+
+    /**
+     * @brief Get the next packet that needs to be sent or, if there is none, the oldest held packets
+     * even if they have not reached the hold time
+     *
+     * @return QueuePacket<Packet<uint8_t>>* The packet or nullptr if there are no packets
+     */
+    static QueuePacket<Packet<uint8_t>>* popPending();
+
+    /**
+     * @brief Returns if there is a packet ready to be sent
+     *
+     */
+    static bool hasReady();
+
+    /**
+     * @brief Returns if there are packets waiting to be aggregated
+     *
+     */
+    static bool hasPending();
+
+    /**
+     * @brief Get the time in ms until the next buffer reaches the hold time
+     *
+     * @return uint32_t
+     */
+    static uint32_t getTimeUntilNextFlush();
+
+    /**
+     * @brief Get the number of data packets that have been sent inside aggregated packets
+     *
+     * @return uint32_t
+     */
+    static uint32_t getAggregatedPacketsNum() { return aggregatedPacketsNum; }
+
+    /**
+     * @brief Delete all the packets held by the service
+     *
+     */
+    static void clear();
+
+private:
+    struct AggregationBuffer {
+        uint16_t via;
+        uint8_t count;
+        uint8_t priority;
+        size_t recordsSize;
+        uint32_t startTime;
+        QueuePacket<Packet<uint8_t>>* packets[LM_AGGREGATION_MAX_PACKETS];
+    };
+
+    /**
+     * @brief Create the packet to be sent with all the packets of the buffer and empty the buffer
+     *
+     * @param buffer Buffer
+     * @return QueuePacket<Packet<uint8_t>>* If there is only one packet it returns the same packet
+     */
+    static QueuePacket<Packet<uint8_t>>* buildPacket(AggregationBuffer& buffer);
+
+    static bool isExpired(AggregationBuffer& buffer);
+
+    static AggregationBuffer buffers[LM_AGGREGATION_BUFFERS];
+
+    static LM_LinkedList<QueuePacket<Packet<uint8_t>>>* readyPackets;
+
+    static uint32_t holdTime;
+
+    static uint32_t aggregatedPacketsNum;
+};
+
+#endif
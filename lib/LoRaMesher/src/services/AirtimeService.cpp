@@ -0,0 +1,85 @@
+#include "AirtimeService.h"
+
+#define LM_AIRTIME_BUCKET_MS 60000UL
+#define LM_AIRTIME_WINDOW_MS (LM_AIRTIME_BUCKET_MS * LM_AIRTIME_WINDOW_BUCKETS)
+
+void AirtimeService::init(uint8_t dutyCycle, uint8_t controlReserve) {
+    AirtimeService::dutyCycle = dutyCycle > 100 ? 100 : dutyCycle;
+    AirtimeService::controlReserve = controlReserve > 100 ? 100 : controlReserve;
+}
+
+void AirtimeService::expireBuckets(uint32_t currentMinute) {
+    for (size_t i = 0; i < LM_AIRTIME_WINDOW_BUCKETS; i++) {
+        if (airtimeBuckets[i] != 0 && currentMinute - bucketMinute[i] >= LM_AIRTIME_WINDOW_BUCKETS) {
+            usedAirtime -= airtimeBuckets[i];
+            airtimeBuckets[i] = 0;
+        }
+    }
+}
+
+void AirtimeService::addAirtime(uint32_t timeOnAir) {
+    uint32_t currentMinute = millis() / LM_AIRTIME_BUCKET_MS;
+    size_t index = currentMinute % LM_AIRTIME_WINDOW_BUCKETS;
+
+    portENTER_CRITICAL(&mux);
+
+    expireBuckets(currentMinute);
+
+    if (bucketMinute[index] != currentMinute) {
+        usedAirtime -= airtimeBuckets[index];
+        airtimeBuckets[index] = 0;
+        bucketMinute[index] = currentMinute;
+    }
+
+    airtimeBuckets[index] += timeOnAir;
+    usedAirtime += timeOnAir;
+
+    portEXIT_CRITICAL(&mux);
+}
+
+uint32_t AirtimeService::getBudget(bool isControl) {
+    uint32_t budget = LM_AIRTIME_WINDOW_MS / 100 * dutyCycle;
+
+    if (isControl)
+        return budget;
+
+    return budget / 100 * (100 - controlReserve);
+}
+
+bool AirtimeService::canSend(uint32_t timeOnAir, bool isControl) {
+    return getUsedAirtime() + timeOnAir <= getBudget(isControl);
+}
+
+uint32_t AirtimeService::getUsedAirtime() {
+    portENTER_CRITICAL(&mux);
+
+    expireBuckets(millis() / LM_AIRTIME_BUCKET_MS);
+    uint32_t used = usedAirtime;
+
+    portEXIT_CRITICAL(&mux);
+
+    return used;
+}
+
+uint32_t AirtimeService::getRemainingAirtime(bool isControl) {
+    uint32_t used = getUsedAirtime();
+    uint32_t budget = getBudget(isControl);
+
+    return used >= budget ? 0 : budget - used;
+}
+
+uint32_t AirtimeService::getTimeUntilRelease() {
+    return LM_AIRTIME_BUCKET_MS - millis() % LM_AIRTIME_BUCKET_MS;
+}
+
+uint32_t AirtimeService::airtimeBuckets[LM_AIRTIME_WINDOW_BUCKETS] = {0};
+
+uint32_t AirtimeService::bucketMinute[LM_AIRTIME_WINDOW_BUCKETS] = {0};
+
+uint32_t AirtimeService::usedAirtime = 0;
+
+uint8_t AirtimeService::dutyCycle = LM_DUTY_CYCLE;
+
+uint8_t AirtimeService::controlReserve = LM_CONTROL_AIRTIME_RESERVE;
+
+portMUX_TYPE AirtimeService::mux = portMUX_INITIALIZER_UNLOCKED;
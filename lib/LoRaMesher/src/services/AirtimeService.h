@@ -0,0 +1,84 @@
+#ifndef _LORAMESHER_AIRTIME_SERVICE_H
+#define _LORAMESHER_AIRTIME_SERVICE_H
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Airtime Service. Accounts the time on air of the sent packets inside a sliding window of one hour
+ * and decides if a packet can be sent without exceeding the duty cycle.
+ * Part of the budget is reserved for control packets, data packets can not use it.
+ *
+ */
+class AirtimeService {
+public:
+    /**
+     * @brief Initialize the Airtime Service
+     *
+     * @param dutyCycle Maximum percentage of the hour that the node can be transmitting
+     * @param controlReserve Percentage of the budget reserved for control packets
+     */
+    static void init(uint8_t dutyCycle, uint8_t controlReserve);
+
+    /**
+     * @brief Add the time on air of a packet that has been sent
+     *
+     * @param timeOnAir Time on air in ms
+     */
+    static void addAirtime(uint32_t timeOnAir);
+
+    /**
+     * @brief Returns if a packet can be sent without exceeding the budget
+     *
+     * @param timeOnAir Time on air of the packet in ms
+     * @param isControl If the packet is a control packet and can use the reserved budget
+     * @return true If the packet can be sent
+     * @return false If the packet needs to wait
+     */
+    static bool canSend(uint32_t timeOnAir, bool isControl);
+
+    /**
+     * @brief Get the airtime used inside the window in ms
+     *
+     * @return uint32_t
+     */
+    static uint32_t getUsedAirtime();
+
+    /**
+     * @brief Get the remaining airtime budget in ms
+     *
+     * @param isControl If true, it includes the budget reserved for control packets
+     * @return uint32_t
+     */
+    static uint32_t getRemainingAirtime(bool isControl);
+
+    /**
+     * @brief Get the time in ms until the oldest part of the window is released
+     *
+     * @return uint32_t
+     */
+    static uint32_t getTimeUntilRelease();
+
+private:
+    /**
+     * @brief Removes the buckets that are outside the window. Needs to be called inside the critical section
+     *
+     * @param currentMinute Current minute since the start
+     */
+    static void expireBuckets(uint32_t currentMinute);
+
+    static uint32_t getBudget(bool isControl);
+
+    static uint32_t airtimeBuckets[LM_AIRTIME_WINDOW_BUCKETS];
+
+    static uint32_t bucketMinute[LM_AIRTIME_WINDOW_BUCKETS];
+
+    static uint32_t usedAirtime;
+
+    static uint8_t dutyCycle;
+
+    static uint8_t controlReserve;
+
+    static portMUX_TYPE mux;
+};
+
+#endif
@@ -0,0 +1,214 @@
+#include "FloodService.h"
+
+void FloodService::init(uint32_t maxDelay, uint8_t redundancy) {
+    portENTER_CRITICAL(&mux);
+
+    FloodService::maxDelay = maxDelay;
+    FloodService::redundancy = redundancy;
+
+    portEXIT_CRITICAL(&mux);
+
+    // Start from a random number, after a reboot the neighbors could still remember the previous ones
+    sequenceNumber = random(0, UINT16_MAX);
+}
+
+uint16_t FloodService::getNextSequenceNumber() {
+    portENTER_CRITICAL(&mux);
+    uint16_t seqNum = ++sequenceNumber;
+    portEXIT_CRITICAL(&mux);
+
+    return seqNum;
+}
+
+bool FloodService::isNew(uint16_t src, uint16_t seqNum) {
+    bool isNew = true;
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&mux);
+
+    FloodOrigin* origin = nullptr;
+    FloodOrigin* oldest = nullptr;
+
+    for (uint8_t i = 0; i < originsNum; i++) {
+        if (origins[i].src == src) {
+            origin = &origins[i];
+            break;
+        }
+
+        if (oldest == nullptr || (int32_t) (origins[i].lastHeard - oldest->lastHeard) < 0)
+            oldest = &origins[i];
+    }
+
+    if (origin == nullptr) {
+        // Replace the origin heard longest ago if there is no space
+        origin = originsNum < LM_FLOOD_ORIGINS ? &origins[originsNum++] : oldest;
+        origin->src = src;
+        origin->lastSeqNum = seqNum;
+        origin->window = 1;
+    }
+    else {
+        int16_t diff = seqNum - origin->lastSeqNum;
+
+        if (diff > 0) {
+            origin->window = diff >= 32 ? 1 : (origin->window << diff) | 1;
+            origin->lastSeqNum = seqNum;
+        }
+        else if (-diff >= 32) {
+            // Too old to be a delayed copy, the origin has been restarted
+            origin->lastSeqNum = seqNum;
+            origin->window = 1;
+        }
+        else if (origin->window & (1u << -diff)) {
+            isNew = false;
+            duplicatePacketsNum++;
+        }
+        else
+            origin->window |= 1u << -diff;
+    }
+
+    origin->lastHeard = now;
+
+    portEXIT_CRITICAL(&mux);
+
+    return isNew;
+}
+
+bool FloodService::schedule(QueuePacket<Packet<uint8_t>>* qp) {
+    ControlPacket* cPacket = reinterpret_cast<ControlPacket*>(qp->packet);
+    uint32_t relayTime = millis() + (maxDelay > 0 ? random(0, maxDelay) : 0);
+    bool scheduled = false;
+
+    portENTER_CRITICAL(&mux);
+
+    for (uint8_t i = 0; i < LM_FLOOD_PENDING; i++) {
+        if (pending[i].qp == nullptr) {
+            pending[i].qp = qp;
+            pending[i].src = cPacket->src;
+            pending[i].seqNum = cPacket->number;
+            pending[i].copies = 1;
+            pending[i].relayTime = relayTime;
+            scheduled = true;
+            break;
+        }
+    }
+
+    portEXIT_CRITICAL(&mux);
+
+    return scheduled;
+}
+
+void FloodService::hearCopy(uint16_t src, uint16_t seqNum) {
+    QueuePacket<Packet<uint8_t>>* suppressed = nullptr;
+
+    portENTER_CRITICAL(&mux);
+
+    for (uint8_t i = 0; i < LM_FLOOD_PENDING; i++) {
+        PendingRelay& relay = pending[i];
+        if (relay.qp == nullptr || relay.src != src || relay.seqNum != seqNum)
+            continue;
+
+        if (relay.copies < UINT8_MAX)
+            relay.copies++;
+
+        // Enough neighbors have relayed it
+        if (redundancy > 0 && relay.copies >= redundancy) {
+            suppressed = relay.qp;
+            relay.qp = nullptr;
+            suppressedPacketsNum++;
+        }
+
+        break;
+    }
+
+    portEXIT_CRITICAL(&mux);
+
+    if (suppressed != nullptr)
+        PacketQueueService::deleteQueuePacketAndPacket(suppressed);
+}
+
+QueuePacket<Packet<uint8_t>>* FloodService::popReady() {
+    QueuePacket<Packet<uint8_t>>* ready = nullptr;
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&mux);
+
+    for (uint8_t i = 0; i < LM_FLOOD_PENDING; i++) {
+        if (pending[i].qp != nullptr && (int32_t) (now - pending[i].relayTime) >= 0) {
+            ready = pending[i].qp;
+            pending[i].qp = nullptr;
+            relayedPacketsNum++;
+            break;
+        }
+    }
+
+    portEXIT_CRITICAL(&mux);
+
+    return ready;
+}
+
+bool FloodService::hasPending() {
+    for (uint8_t i = 0; i < LM_FLOOD_PENDING; i++)
+        if (pending[i].qp != nullptr)
+            return true;
+
+    return false;
+}
+
+uint32_t FloodService::getTimeUntilNextRelay() {
+    uint32_t now = millis();
+    uint32_t wait = UINT32_MAX;
+
+    portENTER_CRITICAL(&mux);
+
+    for (uint8_t i = 0; i < LM_FLOOD_PENDING; i++) {
+        if (pending[i].qp == nullptr)
+            continue;
+
+        int32_t remaining = pending[i].relayTime - now;
+        if (remaining <= 0) {
+            wait = 0;
+            break;
+        }
+
+        if ((uint32_t) remaining < wait)
+            wait = remaining;
+    }
+
+    portEXIT_CRITICAL(&mux);
+
+    return wait;
+}
+
+void FloodService::clear() {
+    for (uint8_t i = 0; i < LM_FLOOD_PENDING; i++) {
+        portENTER_CRITICAL(&mux);
+        QueuePacket<Packet<uint8_t>>* qp = pending[i].qp;
+        pending[i].qp = nullptr;
+        portEXIT_CRITICAL(&mux);
+
+        if (qp != nullptr)
+            PacketQueueService::deleteQueuePacketAndPacket(qp);
+    }
+
+    originsNum = 0;
+}
+
+FloodService::FloodOrigin FloodService::origins[LM_FLOOD_ORIGINS];
+
+uint8_t FloodService::originsNum = 0;
+
+FloodService::PendingRelay FloodService::pending[LM_FLOOD_PENDING] = {};
+
+uint16_t FloodService::sequenceNumber = 0;
+
+uint32_t FloodService::maxDelay = LM_FLOOD_MAX_DELAY_MS;
+
+uint8_t FloodService::redundancy = LM_FLOOD_REDUNDANCY;
+
+uint32_t FloodService::relayedPacketsNum = 0;
+
+uint32_t FloodService::suppressedPacketsNum = 0;
+
+uint32_t FloodService::duplicatePacketsNum = 0;
+
+portMUX_TYPE FloodService::mux = portMUX_INITIALIZER_UNLOCKED;
@@ -0,0 +1,146 @@
+#ifndef _LORAMESHER_FLOOD_SERVICE_H
+#define _LORAMESHER_FLOOD_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include "entities/packets/QueuePacket.h"
+#include "services/PacketService.h"
+#include "services/PacketQueueService.h"
+
+/**
+ * @brief Flood Service. Controlled flooding of the packets sent to the whole network.
+ * Each origin numbers its flooded packets, so the duplicates are detected with a window of the last
+ * sequence numbers of each origin. A new packet is relayed after a random delay and the relay is
+ * suppressed if enough copies of the same packet are heard in the meantime.
+ *
+ */
+class FloodService {
+public:
+    /**
+     * @brief Initialize the Flood Service
+     *
+     * @param maxDelay Maximum random delay in ms before relaying a packet
+     * @param redundancy Copies heard before the relay that suppress it. 0 disables the suppression
+     */
+    static void init(uint32_t maxDelay, uint8_t redundancy);
+
+    /**
+     * @brief Get the sequence number for a new flooded packet of this node
+     *
+     * @return uint16_t
+     */
+    static uint16_t getNextSequenceNumber();
+
+    /**
+     * @brief Returns if the packet has not been received before and remembers it
+     *
+     * @param src Origin of the packet
+     * @param seqNum Sequence number of the packet
+     * @return true If it is new
+     * @return false If it is a duplicate
+     */
+    static bool isNew(uint16_t src, uint16_t seqNum);
+
+    /**
+     * @brief Hold a packet to be relayed after a random delay
+     *
+     * @param qp Queue packet, a FLOOD_P control packet
+     * @return true The packet is held by the service
+     * @return false There is no space, the packet needs to be deleted
+     */
+    static bool schedule(QueuePacket<Packet<uint8_t>>* qp);
+
+    /**
+     * @brief A copy of a packet has been heard. If it is waiting to be relayed and enough copies have
+     * been heard, the relay is suppressed
+     *
+     * @param src Origin of the packet
+     * @param seqNum Sequence number of the packet
+     */
+    static void hearCopy(uint16_t src, uint16_t seqNum);
+
+    /**
+     * @brief Get the next packet whose delay has finished
+     *
+     * @return QueuePacket<Packet<uint8_t>>* The packet to be relayed or nullptr
+     */
+    static QueuePacket<Packet<uint8_t>>* popReady();
+
+    /**
+     * @brief Returns if there are packets waiting to be relayed
+     *
+     */
+    static bool hasPending();
+
+    /**
+     * @brief Get the time in ms until the next packet needs to be relayed
+     *
+     * @return uint32_t
+     */
+    static uint32_t getTimeUntilNextRelay();
+
+    /**
+     * @brief Get the number of flooded packets relayed
+     *
+     * @return uint32_t
+     */
+    static uint32_t getRelayedPacketsNum() { return relayedPacketsNum; }
+
+    /**
+     * @brief Get the number of relays suppressed because enough copies were heard
+     *
+     * @return uint32_t
+     */
+    static uint32_t getSuppressedPacketsNum() { return suppressedPacketsNum; }
+
+    /**
+     * @brief Get the number of duplicate flooded packets received
+     *
+     * @return uint32_t
+     */
+    static uint32_t getDuplicatePacketsNum() { return duplicatePacketsNum; }
+
+    /**
+     * @brief Delete all the packets held by the service
+     *
+     */
+    static void clear();
+
+private:
+    struct FloodOrigin {
+        uint16_t src;
+        uint16_t lastSeqNum;
+        uint32_t window; //Bit i set if lastSeqNum - i has been received
+        uint32_t lastHeard;
+    };
+
+    struct PendingRelay {
+        QueuePacket<Packet<uint8_t>>* qp;
+        uint16_t src;
+        uint16_t seqNum;
+        uint8_t copies;
+        uint32_t relayTime;
+    };
+
+    static FloodOrigin origins[LM_FLOOD_ORIGINS];
+
+    static uint8_t originsNum;
+
+    static PendingRelay pending[LM_FLOOD_PENDING];
+
+    static uint16_t sequenceNumber;
+
+    static uint32_t maxDelay;
+
+    static uint8_t redundancy;
+
+    static uint32_t relayedPacketsNum;
+
+    static uint32_t suppressedPacketsNum;
+
+    static uint32_t duplicatePacketsNum;
+
+    static portMUX_TYPE mux;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "MemoryPoolService.h"
+
+#include "entities/packets/QueuePacket.h"
+
+#include "entities/packets/Packet.h"
+
+#include "utilities/LinkedQueue.hpp"
+
+#ifdef LM_USE_MEMORY_POOL
+
+// The pools are created the first time they are used, so they exist before any static list or packet needs them
+
+LM_MemoryPool& MemoryPoolService::packetPool() {
+    static LM_MemoryPool pool(LM_MAX_PACKET_SIZE, LM_PACKET_POOL_SIZE);
+    return pool;
+}
+
+LM_MemoryPool& MemoryPoolService::queuePacketPool() {
+    static LM_MemoryPool pool(sizeof(QueuePacket<Packet<uint8_t>>), LM_QUEUE_PACKET_POOL_SIZE);
+    return pool;
+}
+
+LM_MemoryPool& MemoryPoolService::listNodePool() {
+    static LM_MemoryPool pool(sizeof(LM_ListNode<void>), LM_LIST_NODE_POOL_SIZE);
+    return pool;
+}
+
+void* MemoryPoolService::allocateFrom(LM_MemoryPool& pool, size_t size) {
+    void* p = pool.Allocate(size);
+    if (p == nullptr)
+        p = pvPortMalloc(size);
+
+    return p;
+}
+
+void MemoryPoolService::releaseTo(LM_MemoryPool& pool, void* p) {
+    if (p == nullptr)
+        return;
+
+    if (!pool.Free(p))
+        vPortFree(p);
+}
+
+void* MemoryPoolService::allocatePacket(size_t size) {
+    return allocateFrom(packetPool(), size);
+}
+
+void MemoryPoolService::freePacket(void* p) {
+    releaseTo(packetPool(), p);
+}
+
+void* MemoryPoolService::allocateQueuePacket(size_t size) {
+    return allocateFrom(queuePacketPool(), size);
+}
+
+void MemoryPoolService::freeQueuePacket(void* p) {
+    releaseTo(queuePacketPool(), p);
+}
+
+void* MemoryPoolService::allocateListNode(size_t size) {
+    return allocateFrom(listNodePool(), size);
+}
+
+void MemoryPoolService::freeListNode(void* p) {
+    releaseTo(listNodePool(), p);
+}
+
+uint32_t MemoryPoolService::getExhaustedNum() {
+    return packetPool().getExhaustedNum() + queuePacketPool().getExhaustedNum() + listNodePool().getExhaustedNum();
+}
+
+uint32_t MemoryPoolService::getOversizedNum() {
+    return packetPool().getOversizedNum() + queuePacketPool().getOversizedNum() + listNodePool().getOversizedNum();
+}
+
+size_t MemoryPoolService::getPacketPoolMinFreeBlocks() {
+    return packetPool().getMinFreeBlocks();
+}
+
+#else
+
+void* MemoryPoolService::allocatePacket(size_t size) {
+    return pvPortMalloc(size);
+}
+
+void MemoryPoolService::freePacket(void* p) {
+    vPortFree(p);
+}
+
+void* MemoryPoolService::allocateQueuePacket(size_t size) {
+    return pvPortMalloc(size);
+}
+
+void MemoryPoolService::freeQueuePacket(void* p) {
+    vPortFree(p);
+}
+
+void* MemoryPoolService::allocateListNode(size_t size) {
+    return pvPortMalloc(size);
+}
+
+void MemoryPoolService::freeListNode(void* p) {
+    vPortFree(p);
+}
+
+uint32_t MemoryPoolService::getExhaustedNum() {
+    return 0;
+}
+
+uint32_t MemoryPoolService::getOversizedNum() {
+    return 0;
+}
+
+size_t MemoryPoolService::getPacketPoolMinFreeBlocks() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef _LORAMESHER_MEMORY_POOL_SERVICE_H
+#define _LORAMESHER_MEMORY_POOL_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include "utilities/MemoryPool.hpp"
+
+/**
+ * @brief Memory Pool Service. Allocates the packets, the queue packets and the list nodes from fixed size pools.
+ * When a pool is empty or the size does not fit, it falls back to the heap.
+ * If LM_USE_MEMORY_POOL is not defined, everything is allocated from the heap.
+ *
+ */
+class MemoryPoolService {
+public:
+    /**
+     * @brief Allocate the memory of a packet
+     *
+     * @param size Size in bytes
+     * @return void* pointer to the memory or nullptr
+     */
+    static void* allocatePacket(size_t size);
+
+    /**
+     * @brief Free the memory of a packet allocated with allocatePacket
+     *
+     * @param p pointer to the packet
+     */
+    static void freePacket(void* p);
+
+    /**
+     * @brief Allocate the memory of a queue packet
+     *
+     * @param size Size in bytes
+     * @return void* pointer to the memory or nullptr
+     */
+    static void* allocateQueuePacket(size_t size);
+
+    /**
+     * @brief Free the memory of a queue packet allocated with allocateQueuePacket
+     *
+     * @param p pointer to the queue packet
+     */
+    static void freeQueuePacket(void* p);
+
+    /**
+     * @brief Allocate the memory of a list node
+     *
+     * @param size Size in bytes
+     * @return void* pointer to the memory or nullptr
+     */
+    static void* allocateListNode(size_t size);
+
+    /**
+     * @brief Free the memory of a list node allocated with allocateListNode
+     *
+     * @param p pointer to the list node
+     */
+    static void freeListNode(void* p);
+
+    /**
+     * @brief Get the number of allocations that used the heap because a pool was empty
+     *
+     * @return uint32_t
+     */
+    static uint32_t getExhaustedNum();
+
+    /**
+     * @brief Get the number of allocations that used the heap because they did not fit in a block
+     *
+     * @return uint32_t
+     */
+    static uint32_t getOversizedNum();
+
+    /**
+     * @brief Get the minimum number of free blocks the packet pool has had
+     *
+     * @return size_t
+     */
+    static size_t getPacketPoolMinFreeBlocks();
+
+#ifdef LM_USE_MEMORY_POOL
+private:
+    static LM_MemoryPool& packetPool();
+
+    static LM_MemoryPool& queuePacketPool();
+
+    static LM_MemoryPool& listNodePool();
+
+    static void* allocateFrom(LM_MemoryPool& pool, size_t size);
+
+    static void releaseTo(LM_MemoryPool& pool, void* p);
+#endif
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define _LORAMESHER_PACKET_FACTORY_H
 
 #include "entities/packets/Packet.h"
+#include "services/MemoryPoolService.h"
 #include "../include/LogManager.h"
 
 class PacketFactory {
@@ -46,7 +47,7 @@ public:
         SAFE_ESP_LOGV("createPacket", "Creating packet with %u bytes.", actualPacketSize);
 
         // Allocate memory for the packet
-        T* packet = static_cast<T*>(pvPortMalloc(actualPacketSize));
+        T* packet = static_cast<T*>(MemoryPoolService::allocatePacket(actualPacketSize));
         if (packet == nullptr) {
             SAFE_ESP_LOGE(LM_TAG, "Failed to allocate packet memory");
             return nullptr;
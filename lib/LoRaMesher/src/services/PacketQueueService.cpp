@@ -1,21 +1,16 @@
 #include "PacketQueueService.h"
 
-void PacketQueueService::addOrdered(LM_LinkedList<QueuePacket<Packet<uint8_t>>>* list, QueuePacket<Packet<uint8_t>>* qp) {
-    list->setInUse();
+bool PacketQueueService::addOrdered(LM_PriorityQueue<QueuePacket<Packet<uint8_t>>>* queue, QueuePacket<Packet<uint8_t>>* qp) {
+    queue->setInUse();
     SAFE_ESP_LOGI("addOrdered", "This packet has type %d and priority %d and number %d", 
                   qp->packet->type, qp->priority, qp->number);
-    if (list->moveToStart()) {
-        do {
-            QueuePacket<Packet<uint8_t>>* current = list->getCurrent();
-            if (current->priority < qp->priority) {
-                list->addCurrent(qp);
-                list->releaseInUse();
-                return;
-            }
-        } while (list->next());
-    }
 
-    list->Append(qp);
+    bool added = queue->Push(qp);
 
-    list->releaseInUse();
+    queue->releaseInUse();
+
+    if (!added)
+        SAFE_ESP_LOGW("addOrdered", "Send queue full, packet with type %d not added", qp->packet->type);
+
+    return added;
 }
\ No newline at end of file
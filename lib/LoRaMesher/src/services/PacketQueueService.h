@@ -9,6 +9,8 @@
 
 #include "utilities/LinkedQueue.hpp"
 
+#include "utilities/PriorityQueue.hpp"
+
 #include "BuildOptions.h"
 
 class PacketQueueService {
@@ -45,7 +47,7 @@ public:
      * @return QueuePacket<T>* QueueElement inside the list
      */
     template<class T>
-    static QueuePacket<T>* findPacketQueue(LM_LinkedList<QueuePacket<T>>* queue, uint8_t num) {
+    static QueuePacket<T>* findPacketQueue(LM_LinkedList<QueuePacket<T>>* queue, uint16_t num) {
         queue->setInUse();
 
         if (queue->moveToStart()) {
@@ -66,12 +68,14 @@ public:
     }
 
     /**
-     * @brief Add the Queue packet into the list ordered
+     * @brief Add the Queue packet into the queue ordered by priority, same priorities keep the insertion order
      *
-     * @param list Linked list to add the QueuePacket
+     * @param queue Priority queue to add the QueuePacket
      * @param qp Queue packet to be added
+     * @return true If the packet has been added
+     * @return false If the queue is full, the packet is not added
      */
-    static void addOrdered(LM_LinkedList<QueuePacket<Packet<uint8_t>>>* list, QueuePacket<Packet<uint8_t>>* qp);
+    static bool addOrdered(LM_PriorityQueue<QueuePacket<Packet<uint8_t>>>* queue, QueuePacket<Packet<uint8_t>>* qp);
 
     /**
      * @brief It will delete the packet queue and the packet inside it
@@ -80,7 +84,7 @@ public:
      */
     static void deleteQueuePacketAndPacket(QueuePacket<Packet<uint8_t>>* pq) {
         ESP_LOGI(LM_TAG, "Deleting packet");
-        vPortFree(pq->packet);
+        MemoryPoolService::freePacket(pq->packet);
 
         ESP_LOGI(LM_TAG, "Deleting packet queue");
         delete pq;
@@ -7,7 +7,7 @@ Packet<uint8_t>* PacketService::createEmptyPacket(size_t packetSize) {
         packetSize = maxPacketSize;
     }
 
-    Packet<uint8_t>* p = static_cast<Packet<uint8_t>*>(pvPortMalloc(packetSize));
+    Packet<uint8_t>* p = static_cast<Packet<uint8_t>*>(MemoryPoolService::allocatePacket(packetSize));
 
     ESP_LOGI(LM_TAG, "Packet created with %d bytes", packetSize);
 
@@ -25,7 +25,7 @@ AppPacket<uint8_t>* PacketService::convertPacket(DataPacket* p) {
 AppPacket<uint8_t>* PacketService::createAppPacket(uint16_t dst, uint16_t src, uint8_t* payload, uint32_t payloadSize) {
     int packetLength = sizeof(AppPacket<uint8_t>) + payloadSize;
 
-    AppPacket<uint8_t>* p = static_cast<AppPacket<uint8_t>*>(pvPortMalloc(packetLength));
+    AppPacket<uint8_t>* p = static_cast<AppPacket<uint8_t>*>(MemoryPoolService::allocatePacket(packetLength));
 
     if (p) {
         //Copy the payload into the packet
@@ -79,11 +79,44 @@ bool PacketService::isXLPacket(uint8_t type) {
     return (type & XL_DATA_P) == XL_DATA_P;
 }
 
+bool PacketService::isAggregatedPacket(uint8_t type) {
+    return type == AGG_DATA_P;
+}
+
+bool PacketService::isSackPacket(uint8_t type) {
+    return type == SACK_P;
+}
+
+bool PacketService::isFloodPacket(uint8_t type) {
+    return type == FLOOD_P;
+}
+
+uint32_t PacketService::getFingerprint(Packet<uint8_t>* p) {
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(p);
+    bool hasVia = isDataPacket(p->type);
+    size_t viaOffset = sizeof(PacketHeader);
+
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < p->packetSize; i++) {
+        if (hasVia && i >= viaOffset && i < viaOffset + sizeof(uint16_t))
+            continue;
+
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
 bool PacketService::isDataControlPacket(uint8_t type) {
     return (isHelloPacket(type) || isAckPacket(type) || isLostPacket(type) || isLostPacket(type));
 }
 
 uint8_t PacketService::getHeaderLength(uint8_t type) {
+    if (isAggregatedPacket(type))
+        return sizeof(DataPacket);
+
     if (isControlPacket(type))
         return sizeof(ControlPacket);
 
@@ -93,7 +126,8 @@ uint8_t PacketService::getHeaderLength(uint8_t type) {
     return 0;
 }
 
-RoutePacket* PacketService::createRoutingPacket(uint16_t localAddress, NetworkNode* nodes, size_t numOfNodes, uint8_t nodeRole) {
+RoutePacket* PacketService::createRoutingPacket(uint16_t localAddress, NetworkNode* nodes, size_t numOfNodes, uint8_t nodeRole,
+    uint8_t flags, uint16_t baseVersion, uint16_t version, uint16_t digest) {
     size_t routingSizeInBytes = numOfNodes * sizeof(NetworkNode);
 
     RoutePacket* routePacket = PacketFactory::createPacket<RoutePacket>(reinterpret_cast<uint8_t*>(nodes), routingSizeInBytes);
@@ -102,6 +136,13 @@ RoutePacket* PacketService::createRoutingPacket(uint16_t localAddress, NetworkNo
     routePacket->type = HELLO_P;
     routePacket->packetSize = routingSizeInBytes + sizeof(RoutePacket);
     routePacket->nodeRole = nodeRole;
+    routePacket->flags = flags;
+    routePacket->fragment = 0;
+    routePacket->fragments = 1;
+    routePacket->baseVersion = baseVersion;
+    routePacket->version = version;
+    routePacket->digest = digest;
+    routePacket->helloInterval = 0;
 
     return routePacket;
 }
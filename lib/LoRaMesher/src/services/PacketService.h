@@ -83,7 +83,7 @@ public:
      */
     template<class T>
     static Packet<uint8_t>* copyPacket(T* p, size_t packetLength) {
-        Packet<uint8_t>* cpPacket = static_cast<Packet<uint8_t>*>(pvPortMalloc(packetLength));
+        Packet<uint8_t>* cpPacket = static_cast<Packet<uint8_t>*>(MemoryPoolService::allocatePacket(packetLength));
 
         if (cpPacket) {
             memcpy(reinterpret_cast<void*>(cpPacket), reinterpret_cast<void*>(p), packetLength);
@@ -103,9 +103,14 @@ public:
      * @param nodes list of NetworkNodes
      * @param numOfNodes Number of nodes
      * @param nodeRole Role of the node
+     * @param flags Route packet flags
+     * @param baseVersion Routing table version the nodes are based on
+     * @param version Routing table version
+     * @param digest Digest of the routing table
      * @return RoutePacket*
      */
-    static RoutePacket* createRoutingPacket(uint16_t localAddress, NetworkNode* nodes, size_t numOfNodes, uint8_t nodeRole);
+    static RoutePacket* createRoutingPacket(uint16_t localAddress, NetworkNode* nodes, size_t numOfNodes, uint8_t nodeRole,
+        uint8_t flags, uint16_t baseVersion, uint16_t version, uint16_t digest);
 
     /**
      * @brief Create a Application Packet
@@ -272,6 +277,42 @@ public:
      */
     static bool isXLPacket(uint8_t type);
 
+    /**
+     * @brief Given a type returns if is an aggregated data packet
+     *
+     * @param type type of the packet
+     * @return true True if needed
+     * @return false If not
+     */
+    static bool isAggregatedPacket(uint8_t type);
+
+    /**
+     * @brief Given a type returns if is a selective ACK packet. It needs to be checked before ACK_P and LOST_P
+     *
+     * @param type type of the packet
+     * @return true True if needed
+     * @return false If not
+     */
+    static bool isSackPacket(uint8_t type);
+
+    /**
+     * @brief Given a type returns if is a flooded packet
+     *
+     * @param type type of the packet
+     * @return true True if needed
+     * @return false If not
+     */
+    static bool isFloodPacket(uint8_t type);
+
+    /**
+     * @brief Get a fingerprint of the packet, all the packet except the via that changes in each hop.
+     * The data packets include the sequence number of their source
+     *
+     * @param p Packet
+     * @return uint32_t Fingerprint
+     */
+    static uint32_t getFingerprint(Packet<uint8_t>* p);
+
     /**
      * @brief Given a type returns if is a Data Control Packet, It will include HELLO_P, ACKs, LOST_P and SYN_P
      *
@@ -1,256 +1,1146 @@
+#include <math.h>
+#include <algorithm>
+#include <new>
+
 #include "RoutingTableService.h"
 #include "services/RoleService.h"
+#include "services/TrickleService.h"
 #include "LoraMesher.h"   
 
-size_t RoutingTableService::routingTableSize()
+void RoutingTableService::init(bool linkQuality, uint8_t hysteresis, size_t tableCapacity, route_eviction_e eviction)
+{
+    linkQualityRouting = linkQuality;
+    routeHysteresis = linkQuality ? hysteresis : 0;
+    evictionPolicy = eviction;
+
+    if (tableCapacity == 0)
+        tableCapacity = 1;
+
+    routingTableList->setInUse();
+
+    if (tableCapacity != capacity)
+    {
+        // Remove the worse routes to keep until the others fit in the new capacity
+        while (routingTableList->getLength() > tableCapacity)
+        {
+            RouteNode *victim = routingTableList->First();
+
+            routingTableList->moveToStart();
+            do
+            {
+                RouteNode *rNode = routingTableList->getCurrent();
+                if (isWorseToKeep(rNode, victim))
+                    victim = rNode;
+
+            } while (routingTableList->next());
+
+            routingTableList->Search(victim);
+
+            ESP_LOGW(LM_TAG, "Routing table capacity reduced, route %X via %X removed", victim->networkNode.address, victim->networkNode.via);
+
+            routingTableIndex->Remove(victim->networkNode.address);
+            routeRemoved(victim);
+            deleteRouteNode(victim);
+            routingTableList->DeleteCurrent();
+        }
+
+        LM_HashIndex<RouteNode> *newIndex = new LM_HashIndex<RouteNode>(tableCapacity);
+        LM_MemoryPool *newPool = new LM_MemoryPool(sizeof(RouteNode), tableCapacity);
+
+        // Move the routes left to the new pool, in the same order
+        for (size_t i = routingTableList->getLength(); i > 0; i--)
+        {
+            RouteNode *rNode = routingTableList->Pop();
+            RouteNode *moved = new (newPool->Allocate(sizeof(RouteNode))) RouteNode(*rNode);
+            deleteRouteNode(rNode);
+
+            routingTableList->Append(moved);
+            newIndex->Insert(moved->networkNode.address, moved);
+        }
+
+        delete routingTableIndex;
+        routingTableIndex = newIndex;
+
+        delete routePool;
+        routePool = newPool;
+
+        capacity = tableCapacity;
+    }
+
+    // The best nodes depend on how the routes are compared
+    bestNodesByRoleValid = 0;
+    memset(bestNodesByRoleNum, 0, sizeof(bestNodesByRoleNum));
+
+    routingTableList->releaseInUse();
+}
+
+size_t RoutingTableService::routingTableSize()
+{
+    return routingTableList->getLength();
+}
+
+RouteNode *RoutingTableService::findNode(uint16_t address)
+{
+    routingTableList->setInUse();
+
+    RouteNode *node = routingTableIndex->Find(address);
+
+    routingTableList->releaseInUse();
+    return node;
+}
+
+RouteNode *RoutingTableService::getBestNodeByRole(uint8_t role)
+{
+    RouteNode *bestNode = nullptr;
+
+    routingTableList->setInUse();
+
+    // Only the single roles are cached
+    if (role != 0 && (role & (role - 1)) == 0 && role <= ROLE_MASK)
+    {
+        uint8_t roleIndex = __builtin_ctz(role);
+        searchBestNodesByRole(roleIndex);
+
+        if (bestNodesByRoleNum[roleIndex] > 0)
+            bestNode = bestNodesByRole[roleIndex][0];
+    }
+    else if (routingTableList->moveToStart())
+    {
+        do
+        {
+            RouteNode *node = routingTableList->getCurrent();
+
+            if ((node->networkNode.role & role) == role && (bestNode == nullptr || isBetterNodeByRole(node, bestNode)))
+                bestNode = node;
+
+        } while (routingTableList->next());
+    }
+
+    routingTableList->releaseInUse();
+    return bestNode;
+}
+
+uint16_t RoutingTableService::getUplinkNodeByRole(uint8_t role, uint16_t src)
+{
+    RouteNode *uplinkNode = nullptr;
+    float bestScore = 0;
+
+    routingTableList->setInUse();
+
+    uint8_t roleIndex = __builtin_ctz(role);
+    searchBestNodesByRole(roleIndex);
+
+    // A node at the maximum load is only used when all the candidates are
+    bool allFull = true;
+    for (uint8_t i = 0; i < bestNodesByRoleNum[roleIndex]; i++)
+        if ((bestNodesByRole[roleIndex][i]->networkNode.role >> LM_UPLINK_LOAD_SHIFT) < LM_UPLINK_LOAD_MAX)
+            allFull = false;
+
+    // Weighted rendezvous hashing, each source sticks to the same node while the weights do not change
+    for (uint8_t i = 0; i < bestNodesByRoleNum[roleIndex]; i++)
+    {
+        RouteNode *node = bestNodesByRole[roleIndex][i];
+
+        uint8_t load = node->networkNode.role >> LM_UPLINK_LOAD_SHIFT;
+        if (load >= LM_UPLINK_LOAD_MAX && !allFull)
+            continue;
+
+        float weight = (float) (LM_UPLINK_LOAD_MAX + 1 - load) / (getRouteCost(&node->networkNode) + 1);
+
+        uint32_t hash = (((uint32_t) src << 16) | node->networkNode.address) * 2654435761u;
+        hash ^= hash >> 15;
+        hash *= 2246822519u;
+        hash ^= hash >> 13;
+
+        // Uniform between 0 and 1, both excluded
+        float uniform = ((float) hash + 1.0f) / 4294967297.0f;
+        float score = -weight / logf(uniform);
+
+        if (uplinkNode == nullptr || score > bestScore)
+        {
+            uplinkNode = node;
+            bestScore = score;
+        }
+    }
+
+    // The route can be removed after the list is released, only the address is returned
+    uint16_t address = uplinkNode != nullptr ? uplinkNode->networkNode.address : 0;
+
+    routingTableList->releaseInUse();
+    return address;
+}
+
+bool RoutingTableService::hasAddressRoutingTable(uint16_t address)
+{
+    RouteNode *node = findNode(address);
+    return node != nullptr;
+}
+
+uint16_t RoutingTableService::getNextHop(uint16_t dst)
+{
+    routingTableList->setInUse();
+
+    RouteNode *node = routingTableIndex->Find(dst);
+    uint16_t via = 0;
+
+    if (node != nullptr)
+    {
+        // Do not wait for the route timeout if the next hop is not sending its hellos
+        if (node->backupViasNum > 0 && isViaStale(node->networkNode.via))
+            failover(node);
+
+        via = node->networkNode.via;
+        // 0 means never used
+        uint32_t now = millis();
+        node->lastUsed = now != 0 ? now : 1;
+    }
+
+    routingTableList->releaseInUse();
+
+    return via;
+}
+
+void RoutingTableService::reportNextHopFailure(uint16_t dst)
+{
+    routingTableList->setInUse();
+
+    RouteNode *node = routingTableIndex->Find(dst);
+
+    if (node != nullptr)
+    {
+        if (node->viaFailures < LM_VIA_MAX_FAILURES)
+            node->viaFailures++;
+
+        if (node->viaFailures >= LM_VIA_MAX_FAILURES)
+            failover(node);
+    }
+
+    routingTableList->releaseInUse();
+}
+
+void RoutingTableService::reportNextHopSuccess(uint16_t dst)
+{
+    routingTableList->setInUse();
+
+    RouteNode *node = routingTableIndex->Find(dst);
+
+    if (node != nullptr)
+        node->viaFailures = 0;
+
+    routingTableList->releaseInUse();
+}
+
+uint8_t RoutingTableService::getNumberOfHops(uint16_t address)
+{
+    routingTableList->setInUse();
+
+    RouteNode *node = routingTableIndex->Find(address);
+    uint8_t metric = node != nullptr ? node->networkNode.metric : 0;
+
+    routingTableList->releaseInUse();
+
+    return metric;
+}
+
+uint8_t RoutingTableService::getRouteRTT(uint16_t address, unsigned long &SRTT, unsigned long &RTTVAR)
+{
+    routingTableList->setInUse();
+
+    RouteNode *node = routingTableIndex->Find(address);
+    uint8_t metric = 0;
+    if (node != nullptr)
+    {
+        metric = node->networkNode.metric;
+        SRTT = node->SRTT * LM_RTT_UNIT_MS;
+        RTTVAR = node->RTTVAR * LM_RTT_UNIT_MS;
+    }
+
+    routingTableList->releaseInUse();
+
+    return metric;
+}
+
+bool RoutingTableService::updateRouteRTT(uint16_t address, unsigned long RTT, unsigned long &SRTT, unsigned long &RTTVAR)
+{
+    routingTableList->setInUse();
+
+    RouteNode *node = routingTableIndex->Find(address);
+    if (node == nullptr)
+    {
+        routingTableList->releaseInUse();
+        return false;
+    }
+
+    SRTT = node->SRTT * LM_RTT_UNIT_MS;
+    RTTVAR = node->RTTVAR * LM_RTT_UNIT_MS;
+
+    // First time RTT is calculated for this node (RFC 6298)
+    if (SRTT == 0)
+    {
+        SRTT = RTT;
+        RTTVAR = RTT / 2;
+    }
+    else
+    {
+        unsigned long absRTT = (SRTT > RTT) ? (SRTT - RTT) : (RTT - SRTT);
+        RTTVAR = std::min((RTTVAR * 3 + absRTT) / 4, 100000UL);
+        SRTT = std::min((SRTT * 7 + RTT) / 8, 100000UL);
+    }
+
+    // The route keeps them in LM_RTT_UNIT_MS units, a SRTT of 0 means no RTT yet
+    node->SRTT = std::max(SRTT / LM_RTT_UNIT_MS, 1UL);
+    node->RTTVAR = RTTVAR / LM_RTT_UNIT_MS;
+
+    routingTableList->releaseInUse();
+
+    return true;
+}
+
+bool RoutingTableService::processRoute(RoutePacket *p, int8_t receivedSNR)
+{
+    if (p->packetSize < sizeof(RoutePacket) || (p->packetSize - sizeof(RoutePacket)) % sizeof(NetworkNode) != 0)
+    {
+        SAFE_ESP_LOGE(LM_TAG, "Invalid route packet size");
+        return false;
+    }
+
+    size_t numNodes = p->getNetworkNodesSize();
+    ESP_LOGI(LM_TAG, "Route packet from %X with size %d, flags %d, version %d", p->src, numNodes, p->flags, p->version);
+
+    // The routes via the sender need to live until its next hellos
+    uint32_t timeout = p->helloInterval == 0 ? DEFAULT_TIMEOUT * 1000 : p->helloInterval * LM_ROUTE_TIMEOUT_INTERVALS * 1000;
+    uint16_t previousVersion = tableVersion;
+
+    // Only the first packet of each numbered hello counts for the reception ratio, the full hello requests are not numbered
+    bool scheduled = p->fragment == 0 && (p->flags & HELLO_REQUEST_FULL_F) == 0;
+    NeighborNode *neighbor = addNeighbor(p->src, timeout);
+    uint8_t linkCost = updateLinkCost(neighbor, p->helloInterval, p->helloSequence, receivedSNR, scheduled);
+
+    NetworkNode *receivedNode = new NetworkNode(p->src, 1, p->nodeRole, linkCost);
+    processRoute(p->src, receivedNode, timeout);
+    delete receivedNode;
+
+    resetReceiveSNRRoutePacket(p->src, receivedSNR);
+
+    if (p->flags & HELLO_REQUEST_FULL_F)
+    {
+        if (p->dst == WiFiService::getLocalAddress())
+        {
+            ESP_LOGI(LM_TAG, "Full hello requested by %X", p->src);
+            fullHelloRequested = true;
+        }
+
+        return false;
+    }
+
+    bool isFull = p->flags & HELLO_FULL_F;
+
+    // A delta can only be applied over the version we already have
+    bool synchronized = isFull || (neighbor->helloSynchronized && p->baseVersion == neighbor->helloVersion);
+
+    if (synchronized && (p->fragment == 0 || neighbor->pendingHelloVersion != p->version))
+    {
+        neighbor->pendingHelloVersion = p->version;
+        neighbor->pendingHelloFragments = 0;
+
+        if (isFull)
+            neighbor->receivingFullHelloId = ++fullHelloId;
+    }
+
+    for (size_t i = 0; i < numNodes; i++)
+    {
+        NetworkNode *node = &p->networkNodes[i];
+
+        // A route through ourselves is not valid for us (poisoned reverse)
+        if (node->metric >= LM_UNREACHABLE_METRIC - 1 || node->via == WiFiService::getLocalAddress())
+        {
+            removeRoute(node->address, p->src);
+            continue;
+        }
+
+        node->metric++;
+        node->cost = node->cost > UINT8_MAX - linkCost ? UINT8_MAX : node->cost + linkCost;
+        processRoute(p->src, node, timeout);
+
+        if (isFull && synchronized)
+        {
+            routingTableList->setInUse();
+
+            RouteNode *rNode = routingTableIndex->Find(node->address);
+            if (rNode != nullptr && rNode->networkNode.via == p->src)
+                rNode->fullHelloId = neighbor->receivingFullHelloId;
+
+            routingTableList->releaseInUse();
+        }
+    }
+
+    printRoutingTable();
+
+    if (!synchronized)
+    {
+        ESP_LOGW(LM_TAG, "Hello from %X based on version %d, we have %d", p->src, p->baseVersion, neighbor->helloVersion);
+        neighbor->helloSynchronized = false;
+        return canRequestFullHello(neighbor);
+    }
+
+    neighbor->pendingHelloFragments++;
+    if (neighbor->pendingHelloFragments >= p->fragments)
+    {
+        // Without changes the digest needs to be the same we already have
+        if (!isFull && p->baseVersion == p->version && p->digest != neighbor->helloDigest)
+        {
+            ESP_LOGW(LM_TAG, "Routing table digest mismatch from %X", p->src);
+            neighbor->helloSynchronized = false;
+            return canRequestFullHello(neighbor);
+        }
+
+        neighbor->helloSynchronized = true;
+        neighbor->helloVersion = p->version;
+        neighbor->helloDigest = p->digest;
+
+        if (isFull)
+            removeStaleRoutes(p->src, neighbor->receivingFullHelloId);
+    }
+
+    // The routes via a synchronized neighbor are still valid even if they have not been sent again
+    if (neighbor->helloSynchronized)
+    {
+        resetTimeoutRoutesVia(p->src, timeout);
+
+        if (tableVersion == previousVersion)
+            TrickleService::hearConsistent();
+    }
+
+    return false;
+}
+
+void RoutingTableService::resetReceiveSNRRoutePacket(uint16_t src, int8_t receivedSNR)
+{
+    routingTableList->setInUse();
+
+    NeighborNode *neighbor = findNeighbor(src);
+    if (neighbor != nullptr)
+    {
+        ESP_LOGI(LM_TAG, "Reset Receive SNR from %X: %d", src, receivedSNR);
+
+        neighbor->receivedSNR = receivedSNR;
+    }
+
+    routingTableList->releaseInUse();
+}
+
+void RoutingTableService::processRoute(uint16_t via, NetworkNode *node, uint32_t timeout)
+{
+    if (node->address != WiFiService::getLocalAddress())
+    {
+        // The route can not be removed nor changed by other tasks while it is updated
+        routingTableList->setInUse();
+
+        RouteNode *rNode = routingTableIndex->Find(node->address);
+        // If nullptr the node is not inside the routing table, then add it
+        if (rNode == nullptr)
+        {
+            if (isHeldDown(node))
+                ESP_LOGW(LM_TAG, "Route for %X via %X metric %d held down", node->address, via, node->metric);
+            else
+                addNodeToRoutingTable(node, via, timeout);
+
+            routingTableList->releaseInUse();
+            return;
+        }
+
+        uint8_t newCost = getRouteCost(node);
+        uint8_t actualCost = getRouteCost(&rNode->networkNode);
+        NetworkNode previous = rNode->networkNode;
+
+        // Change the next hop only if the new route is better by the hysteresis, to prevent flapping
+        if (rNode->networkNode.via != via && newCost + routeHysteresis < actualCost)
+        {
+            // The actual next hop becomes an alternative one
+            addBackupVia(rNode, rNode->networkNode.via, rNode->networkNode.metric, rNode->networkNode.cost, rNode->timeout);
+            removeBackupVia(rNode, via);
+
+            rNode->viaFailures = 0;
+            rNode->networkNode.metric = node->metric;
+            rNode->networkNode.cost = node->cost;
+            rNode->networkNode.via = via;
+            resetTimeoutRoutingNode(rNode, timeout);
+            routeChanged(rNode);
+            TrickleService::reset();
+            SAFE_ESP_LOGI(LM_TAG, "Found better route for %X via %X metric %d cost %d", node->address, via, node->metric, node->cost);
+        }
+        else if (rNode->networkNode.via == via)
+        {
+            // The next hop only sends the changes, follow it even if the route is worse now.
+            // Small changes of the cost are not advertised until the next full hello
+            int costChange = abs((int) node->cost - (int) rNode->networkNode.cost);
+
+            if (node->metric != rNode->networkNode.metric || costChange >= LM_ETX_HYSTERESIS)
+            {
+                rNode->networkNode.metric = node->metric;
+                rNode->networkNode.cost = node->cost;
+                routeChanged(rNode);
+                SAFE_ESP_LOGI(LM_TAG, "Route for %X via %X changed to metric %d cost %d", node->address, via, node->metric, node->cost);
+            }
+            else
+                rNode->networkNode.cost = node->cost;
+
+            resetTimeoutRoutingNode(rNode, timeout);
+        }
+        else
+        {
+            addBackupVia(rNode, via, node->metric, node->cost, millis() + timeout);
+
+            // Reset the timeout, only when the route is as good as the actual route.
+            if (newCost <= actualCost)
+                resetTimeoutRoutingNode(rNode, timeout);
+        }
+
+        // Update the Role only if the node that sent the packet is the next hop
+        if (rNode->networkNode.via == via && node->role != rNode->networkNode.role)
+        {
+            ESP_LOGI(LM_TAG, "Updating role of %X to %d", node->address, node->role);
+            rNode->networkNode.role = node->role;
+            routeChanged(rNode);
+        }
+
+        if (previous.metric != rNode->networkNode.metric || previous.cost != rNode->networkNode.cost ||
+            previous.role != rNode->networkNode.role)
+            updateBestNodeByRole(rNode);
+
+        routingTableList->releaseInUse();
+    }
+}
+
+void RoutingTableService::addNodeToRoutingTable(NetworkNode *node, uint16_t via, uint32_t timeout)
+{
+    if (routingTableList->getLength() >= capacity && !evictRoute(node))
+    {
+        ESP_LOGW(LM_TAG, "Routing table full, route %X via %X metric %d not added", node->address, via, node->metric);
+        return;
+    }
+
+    RouteNode *rNode = createRouteNode(node, via);
+    if (rNode == nullptr)
+    {
+        ESP_LOGE(LM_TAG, "Route pool empty, route %X via %X not added", node->address, via);
+        return;
+    }
+
+    // Reset the timeout of the node
+    resetTimeoutRoutingNode(rNode, timeout);
+
+    routingTableList->Append(rNode);
+    routingTableIndex->Insert(rNode->networkNode.address, rNode);
+
+    rNode->version = ++tableVersion;
+
+    updateBestNodeByRole(rNode);
+
+    ESP_LOGI(LM_TAG, "New route added: %X via %X metric %d, cost %d, role %d", node->address, via, node->metric, node->cost, node->role);
+
+    TrickleService::reset();
+}
+
+RouteNode *RoutingTableService::createRouteNode(NetworkNode *node, uint16_t via)
+{
+    void *memory = routePool->Allocate(sizeof(RouteNode));
+    if (memory == nullptr)
+        return nullptr;
+
+    return new (memory) RouteNode(node->address, node->metric, node->role, via, node->cost);
+}
+
+void RoutingTableService::deleteRouteNode(RouteNode *node)
+{
+    node->~RouteNode();
+    routePool->Free(node);
+}
+
+bool RoutingTableService::evictRoute(NetworkNode *node)
+{
+    RouteNode *victim = nullptr;
+
+    if (routingTableList->moveToStart())
+    {
+        do
+        {
+            RouteNode *rNode = routingTableList->getCurrent();
+
+            // The routes being used keep their next hops and round-trip times
+            if (getIdleTime(rNode) < LM_ROUTE_ACTIVE_S * 1000UL)
+                continue;
+
+            if (victim == nullptr || isWorseToKeep(rNode, victim))
+                victim = rNode;
+
+        } while (routingTableList->next());
+    }
+
+    if (victim == nullptr)
+        return false;
+
+    // Only the least recently used policy replaces a route with a worse one
+    if (evictionPolicy != LM_EVICT_LEAST_RECENTLY_USED)
+    {
+        bool isNeighbor = node->metric == 1;
+        bool isVictimNeighbor = victim->networkNode.metric == 1;
+
+        if (evictionPolicy == LM_EVICT_NON_NEIGHBOR_FIRST && isNeighbor != isVictimNeighbor)
+        {
+            if (!isNeighbor)
+                return false;
+        }
+        else if (getRouteCost(node) >= getRouteCost(&victim->networkNode))
+            return false;
+    }
+
+    if (!routingTableList->Search(victim))
+        return false;
+
+    uint16_t address = victim->networkNode.address;
+    ESP_LOGW(LM_TAG, "Routing table full, route %X via %X replaced by %X", address, victim->networkNode.via, node->address);
+
+    routingTableIndex->Remove(address);
+    routeRemoved(victim);
+    deleteRouteNode(victim);
+    routingTableList->DeleteCurrent();
+
+    evictedRoutesNum++;
+    return true;
+}
+
+uint32_t RoutingTableService::getIdleTime(RouteNode *node)
+{
+    // The routes never used are the idle ones for the longest time
+    if (node->lastUsed == 0)
+        return UINT32_MAX;
+
+    return millis() - node->lastUsed;
+}
+
+bool RoutingTableService::isWorseToKeep(RouteNode *node, RouteNode *victim)
+{
+    uint32_t idle = getIdleTime(node);
+    uint32_t victimIdle = getIdleTime(victim);
+    uint8_t cost = getRouteCost(&node->networkNode);
+    uint8_t victimCost = getRouteCost(&victim->networkNode);
+
+    if (evictionPolicy == LM_EVICT_LEAST_RECENTLY_USED)
+        return idle != victimIdle ? idle > victimIdle : cost > victimCost;
+
+    if (evictionPolicy == LM_EVICT_NON_NEIGHBOR_FIRST)
+    {
+        bool isNeighbor = node->networkNode.metric == 1;
+        bool isVictimNeighbor = victim->networkNode.metric == 1;
+
+        if (isNeighbor != isVictimNeighbor)
+            return !isNeighbor;
+    }
+
+    // The least recently used breaks the ties
+    return cost != victimCost ? cost > victimCost : idle > victimIdle;
+}
+
+NeighborNode *RoutingTableService::findNeighbor(uint16_t address)
+{
+    if (address == 0)
+        return nullptr;
+
+    for (size_t i = 0; i < LM_MAX_NEIGHBORS; i++)
+    {
+        if (neighbors[i].address == address)
+            return &neighbors[i];
+    }
+
+    return nullptr;
+}
+
+NeighborNode *RoutingTableService::addNeighbor(uint16_t address, uint32_t timeout)
+{
+    routingTableList->setInUse();
+
+    NeighborNode *neighbor = findNeighbor(address);
+
+    if (neighbor == nullptr)
+    {
+        // A free entry or the neighbor that expires first
+        neighbor = &neighbors[0];
+        for (size_t i = 1; i < LM_MAX_NEIGHBORS && neighbor->address != 0; i++)
+        {
+            if (neighbors[i].address == 0 || neighbors[i].timeout < neighbor->timeout)
+                neighbor = &neighbors[i];
+        }
+
+        if (neighbor->address != 0)
+            ESP_LOGW(LM_TAG, "Neighbors full, %X replaced by %X", neighbor->address, address);
+
+        *neighbor = NeighborNode(address);
+    }
+
+    neighbor->timeout = millis() + timeout;
+
+    routingTableList->releaseInUse();
+
+    return neighbor;
+}
+
+size_t RoutingTableService::getMemory()
+{
+    return routePool->getBlockSize() * routePool->getBlockCount() + routingTableIndex->getMemory() + sizeof(neighbors);
+}
+
+NetworkNode *RoutingTableService::getAllNetworkNodes()
+{
+    routingTableList->setInUse();
+
+    int routingSize = routingTableSize();
+
+    // If the routing table is empty return nullptr
+    if (routingSize == 0)
+    {
+        routingTableList->releaseInUse();
+        return nullptr;
+    }
+
+    NetworkNode *payload = new NetworkNode[routingSize];
+
+    if (routingTableList->moveToStart())
+    {
+        for (int i = 0; i < routingSize; i++)
+        {
+            RouteNode *currentNode = routingTableList->getCurrent();
+            payload[i] = currentNode->networkNode;
+
+            if (!routingTableList->next())
+                break;
+        }
+    }
+
+    routingTableList->releaseInUse();
+
+    return payload;
+}
+
+NetworkNode *RoutingTableService::getHelloNetworkNodes(bool &full, size_t &numNodes, uint16_t &baseVersion, uint16_t &version, uint16_t &digest)
+{
+    routingTableList->setInUse();
+
+    full = full || fullHelloRequested;
+
+    size_t routingSize = routingTableList->getLength();
+    size_t maxNodes = full ? routingSize : removedRoutesNum + routingSize;
+
+    NetworkNode *payload = maxNodes > 0 ? new NetworkNode[maxNodes] : nullptr;
+
+    numNodes = 0;
+    digest = 0;
+
+    // A full hello replaces the routing table of the neighbors, the removed routes are not needed
+    if (!full)
+    {
+        for (size_t i = 0; i < removedRoutesNum; i++)
+            payload[numNodes++] = removedRoutes[i];
+    }
+
+    if (routingTableList->moveToStart())
+    {
+        do
+        {
+            RouteNode *currentNode = routingTableList->getCurrent();
+
+            if (full || (int16_t) (currentNode->version - advertisedVersion) > 0)
+                payload[numNodes++] = currentNode->networkNode;
+
+            digest += getDigest(&currentNode->networkNode);
+
+        } while (routingTableList->next());
+    }
+
+    baseVersion = advertisedVersion;
+    version = tableVersion;
+
+    // From now on, the changes are considered advertised
+    advertisedVersion = tableVersion;
+    removedRoutesNum = 0;
+    fullHelloRequested = false;
+    lastHelloTime = millis();
+
+    routingTableList->releaseInUse();
+
+    if (numNodes == 0 && payload != nullptr)
+    {
+        delete[] payload;
+        payload = nullptr;
+    }
+
+    return payload;
+}
+
+bool RoutingTableService::isFullHelloRequested()
+{
+    return fullHelloRequested;
+}
+
+bool RoutingTableService::hasHelloChanges()
+{
+    return fullHelloRequested || removedRoutesNum != 0 || tableVersion != advertisedVersion;
+}
+
+uint32_t RoutingTableService::getTimeUntilTriggeredHello()
 {
-    return routingTableList->getLength();
+    if (removedRoutesNum == 0)
+        return UINT32_MAX;
+
+    uint32_t elapsed = millis() - lastHelloTime;
+    return elapsed >= LM_TRIGGERED_HELLO_MIN_MS ? 0 : LM_TRIGGERED_HELLO_MIN_MS - elapsed;
 }
 
-RouteNode *RoutingTableService::findNode(uint16_t address)
+void RoutingTableService::resetTimeoutRoutingNode(RouteNode *node, uint32_t timeout)
+{
+    node->timeout = millis() + timeout;
+}
+
+void RoutingTableService::printRoutingTable()
 {
+    SAFE_ESP_LOGI(LM_TAG, "Current routing table:");
+
     routingTableList->setInUse();
 
     if (routingTableList->moveToStart())
     {
+        size_t position = 0;
+
         do
         {
             RouteNode *node = routingTableList->getCurrent();
 
-            if (node->networkNode.address == address)
-            {
-                routingTableList->releaseInUse();
-                return node;
-            }
+            SAFE_ESP_LOGI("printRoutingTable", "%d - %X via %X metric %d cost %d Role %d", position,
+                          node->networkNode.address,
+                          node->networkNode.via,
+                          node->networkNode.metric,
+                          node->networkNode.cost,
+                          node->networkNode.role);
 
+            position++;
         } while (routingTableList->next());
     }
 
     routingTableList->releaseInUse();
-    return nullptr;
 }
 
-RouteNode *RoutingTableService::getBestNodeByRole(uint8_t role)
+void RoutingTableService::manageTimeoutRoutingTable()
 {
-    RouteNode *bestNode = nullptr;
+    ESP_LOGI(LM_TAG, "Checking routes timeout");
 
     routingTableList->setInUse();
 
+    for (size_t i = 0; i < LM_MAX_NEIGHBORS; i++)
+    {
+        if (neighbors[i].address != 0 && neighbors[i].timeout < millis())
+        {
+            ESP_LOGW(LM_TAG, "Neighbor timeout %X", neighbors[i].address);
+            neighbors[i] = NeighborNode();
+        }
+    }
+
     if (routingTableList->moveToStart())
     {
         do
         {
             RouteNode *node = routingTableList->getCurrent();
 
-            if ((node->networkNode.role & role) == role &&
-                (bestNode == nullptr || node->networkNode.metric < bestNode->networkNode.metric))
+            if (node->backupViasNum > 0 && isViaStale(node->networkNode.via))
+                failover(node);
+
+            // The neighbors table is bounded and its entries can be replaced, the routes only expire by their timeout
+            if (node->timeout < millis())
             {
-                bestNode = node;
+                ESP_LOGW(LM_TAG, "Route timeout %X via %X", node->networkNode.address, node->networkNode.via);
+
+                if (failover(node))
+                    continue;
+
+                routingTableIndex->Remove(node->networkNode.address);
+                routeRemoved(node);
+                deleteRouteNode(node);
+                routingTableList->DeleteCurrent();
             }
 
         } while (routingTableList->next());
     }
 
     routingTableList->releaseInUse();
-    return bestNode;
-}
 
-bool RoutingTableService::hasAddressRoutingTable(uint16_t address)
-{
-    RouteNode *node = findNode(address);
-    return node != nullptr;
+    printRoutingTable();
 }
 
-uint16_t RoutingTableService::getNextHop(uint16_t dst)
+void RoutingTableService::removeRoute(uint16_t address, uint16_t via)
 {
-    RouteNode *node = findNode(dst);
+    routingTableList->setInUse();
 
-    if (node == nullptr)
-        return 0;
+    RouteNode *node = routingTableIndex->Find(address);
+
+    // Only the next hop can remove the route, the other ones only remove their alternative
+    if (node != nullptr && node->networkNode.via != via)
+        removeBackupVia(node, via);
+    else if (node != nullptr && !failover(node) && routingTableList->Search(node))
+    {
+        ESP_LOGW(LM_TAG, "Route removed %X via %X", address, via);
+
+        routingTableIndex->Remove(address);
+        routeRemoved(node);
+        deleteRouteNode(node);
+        routingTableList->DeleteCurrent();
+    }
 
-    return node->via;
+    routingTableList->releaseInUse();
 }
 
-uint8_t RoutingTableService::getNumberOfHops(uint16_t address)
+void RoutingTableService::removeStaleRoutes(uint16_t via, uint16_t helloId)
 {
-    RouteNode *node = findNode(address);
+    routingTableList->setInUse();
 
-    if (node == nullptr)
-        return 0;
+    if (routingTableList->moveToStart())
+    {
+        do
+        {
+            RouteNode *node = routingTableList->getCurrent();
+
+            if (node->networkNode.via == via && node->networkNode.address != via && node->fullHelloId != helloId)
+            {
+                ESP_LOGW(LM_TAG, "Route %X not found in the full hello of %X", node->networkNode.address, via);
+
+                if (failover(node))
+                    continue;
+
+                routingTableIndex->Remove(node->networkNode.address);
+                routeRemoved(node);
+                deleteRouteNode(node);
+                routingTableList->DeleteCurrent();
+            }
+
+        } while (routingTableList->next());
+    }
 
-    return node->networkNode.metric;
+    routingTableList->releaseInUse();
 }
 
-void RoutingTableService::processRoute(RoutePacket *p, int8_t receivedSNR)
+void RoutingTableService::resetTimeoutRoutesVia(uint16_t via, uint32_t timeout)
 {
-    if ((p->packetSize - sizeof(RoutePacket)) % sizeof(NetworkNode) != 0)
-    {
-        SAFE_ESP_LOGE(LM_TAG, "Invalid route packet size");
-        return;
-    }
+    routingTableList->setInUse();
 
-    size_t numNodes = p->getNetworkNodesSize();
-    ESP_LOGI(LM_TAG, "Route packet from %X with size %d", p->src, numNodes);
+    if (routingTableList->moveToStart())
+    {
+        do
+        {
+            RouteNode *node = routingTableList->getCurrent();
 
-    NetworkNode *receivedNode = new NetworkNode(p->src, 1, p->nodeRole);
-    processRoute(p->src, receivedNode);
-    delete receivedNode;
+            if (node->networkNode.via == via)
+                resetTimeoutRoutingNode(node, timeout);
 
-    resetReceiveSNRRoutePacket(p->src, receivedSNR);
+            for (uint8_t i = 0; i < node->backupViasNum; i++)
+            {
+                if (node->backupVias[i].via == via)
+                    node->backupVias[i].timeout = millis() + timeout;
+            }
 
-    for (size_t i = 0; i < numNodes; i++)
-    {
-        NetworkNode *node = &p->networkNodes[i];
-        node->metric++;
-        processRoute(p->src, node);
+        } while (routingTableList->next());
     }
 
-    printRoutingTable();
+    routingTableList->releaseInUse();
 }
 
-void RoutingTableService::resetReceiveSNRRoutePacket(uint16_t src, int8_t receivedSNR)
+bool RoutingTableService::canRequestFullHello(NeighborNode *neighbor)
 {
-    RouteNode *rNode = findNode(src);
-    if (rNode == nullptr)
-        return;
+    uint32_t now = millis();
 
-    ESP_LOGI(LM_TAG, "Reset Receive SNR from %X: %d", src, receivedSNR);
+    // Do not ask again before the neighbor had time to answer
+    if (neighbor->fullHelloRequestTime != 0 && now - neighbor->fullHelloRequestTime < HELLO_PACKETS_DELAY * 1000)
+        return false;
 
-    rNode->receivedSNR = receivedSNR;
+    neighbor->fullHelloRequestTime = now;
+    return true;
 }
 
-void RoutingTableService::processRoute(uint16_t via, NetworkNode *node)
+void RoutingTableService::routeChanged(RouteNode *node)
 {
-    if (node->address != WiFiService::getLocalAddress())
-    {
+    node->version = ++tableVersion;
+}
 
-        RouteNode *rNode = findNode(node->address);
-        // If nullptr the node is not inside the routing table, then add it
-        if (rNode == nullptr)
-        {
-            addNodeToRoutingTable(node, via);
-            return;
-        }
+void RoutingTableService::routeRemoved(RouteNode *node)
+{
+    uint16_t address = node->networkNode.address;
 
-        // Update the metric and restart timeout if needed
-        if (node->metric < rNode->networkNode.metric)
-        {
-            rNode->networkNode.metric = node->metric;
-            rNode->via = via;
-            resetTimeoutRoutingNode(rNode);
-            SAFE_ESP_LOGI(LM_TAG, "Found better route for %X via %X metric %d", node->address, via, node->metric);
-        }
-        else if (node->metric == rNode->networkNode.metric)
-        {
-            // Reset the timeout, only when the metric is the same as the actual route.
-            resetTimeoutRoutingNode(rNode);
-        }
+    tableVersion++;
 
-        // Update the Role only if the node that sent the packet is the next hop
-        if (getNextHop(node->address) == via && node->role != rNode->networkNode.role)
+    // The next queries of the roles it was one of the best nodes for need to search again. The entry goes back
+    // to the pool, so it can not stay in the best nodes until then
+    for (uint8_t i = 0; i < ROLE_BITS; i++)
+    {
+        if (isBestNodeByRole(i, node))
         {
-            ESP_LOGI(LM_TAG, "Updating role of %X to %d", node->address, node->role);
-            rNode->networkNode.role = node->role;
+            bestNodesByRoleValid &= ~(1 << i);
+            bestNodesByRoleNum[i] = 0;
         }
     }
+
+    heldDownRoutes[heldDownRoutesNext] = {address, node->networkNode.metric, millis()};
+    heldDownRoutesNext = (heldDownRoutesNext + 1) % LM_MAX_REMOVED_ROUTES;
+
+    // If there is no space to remember the route, the neighbors will find out with a full hello
+    if (removedRoutesNum < LM_MAX_REMOVED_ROUTES)
+        removedRoutes[removedRoutesNum++] = NetworkNode(address, LM_UNREACHABLE_METRIC, 0, UINT8_MAX);
+    else
+        fullHelloRequested = true;
+
+    // The neighbors need to know it soon
+    TrickleService::reset();
 }
 
-void RoutingTableService::addNodeToRoutingTable(NetworkNode *node, uint16_t via)
+void RoutingTableService::addBackupVia(RouteNode *rNode, uint16_t via, uint8_t metric, uint8_t cost, uint32_t timeout)
 {
-    if (routingTableList->getLength() >= RTMAXSIZE)
-    {
-        ESP_LOGW(LM_TAG, "Routing table max size reached, not adding route and deleting it");
-        return;
-    }
+    removeBackupVia(rNode, via);
+
+    uint8_t newCost = linkQualityRouting ? cost : metric;
 
-    if (calculateMaximumMetricOfRoutingTable() < node->metric)
+    // Find its position, the best one first
+    uint8_t position = 0;
+    while (position < rNode->backupViasNum)
     {
-        ESP_LOGW(LM_TAG, "Trying to add a route with a metric higher than the maximum of the routing table, not adding route and deleting it");
-        return;
+        BackupVia *backup = &rNode->backupVias[position];
+        if (newCost < (linkQualityRouting ? backup->cost : backup->metric))
+            break;
+
+        position++;
     }
 
-    RouteNode *rNode = new RouteNode(node->address, node->metric, node->role, via);
+    if (position >= LM_BACKUP_VIAS)
+        return;
 
-    // Reset the timeout of the node
-    resetTimeoutRoutingNode(rNode);
+    size_t toMove = rNode->backupViasNum - position;
+    if (rNode->backupViasNum == LM_BACKUP_VIAS)
+        toMove--;
+    else
+        rNode->backupViasNum++;
 
-    routingTableList->setInUse();
+    memmove(&rNode->backupVias[position + 1], &rNode->backupVias[position], toMove * sizeof(BackupVia));
 
-    routingTableList->Append(rNode);
+    rNode->backupVias[position] = {via, metric, cost, timeout};
+}
 
-    routingTableList->releaseInUse();
+void RoutingTableService::removeBackupVia(RouteNode *rNode, uint16_t via)
+{
+    for (uint8_t i = 0; i < rNode->backupViasNum; i++)
+    {
+        if (rNode->backupVias[i].via != via)
+            continue;
 
-    ESP_LOGI(LM_TAG, "New route added: %X via %X metric %d, role %d", node->address, via, node->metric, node->role);
+        memmove(&rNode->backupVias[i], &rNode->backupVias[i + 1], (rNode->backupViasNum - i - 1) * sizeof(BackupVia));
+        rNode->backupViasNum--;
+        return;
+    }
 }
 
-NetworkNode *RoutingTableService::getAllNetworkNodes()
+bool RoutingTableService::isViaStale(uint16_t via)
 {
-    routingTableList->setInUse();
+    NeighborNode *neighbor = findNeighbor(via);
 
-    int routingSize = routingTableSize();
+    // Without its link state, the route timeout decides
+    if (neighbor == nullptr)
+        return false;
 
-    // If the routing table is empty return nullptr
-    if (routingSize == 0)
-    {
-        routingTableList->releaseInUse();
-        return nullptr;
-    }
+    if (neighbor->lastHelloTime == 0 || neighbor->helloInterval == 0)
+        return false;
 
-    NetworkNode *payload = new NetworkNode[routingSize];
+    return millis() - neighbor->lastHelloTime > (uint32_t) neighbor->helloInterval * 1000 * LM_VIA_STALE_INTERVALS;
+}
 
-    if (routingTableList->moveToStart())
+bool RoutingTableService::failover(RouteNode *rNode)
+{
+    uint32_t now = millis();
+
+    for (uint8_t i = 0; i < rNode->backupViasNum; i++)
     {
-        for (int i = 0; i < routingSize; i++)
-        {
-            RouteNode *currentNode = routingTableList->getCurrent();
-            payload[i] = currentNode->networkNode;
+        BackupVia backup = rNode->backupVias[i];
 
-            if (!routingTableList->next())
-                break;
-        }
-    }
+        if (backup.timeout < now || isViaStale(backup.via))
+            continue;
 
-    routingTableList->releaseInUse();
+        // The previous alternatives are not valid either
+        memmove(&rNode->backupVias[0], &rNode->backupVias[i + 1], (rNode->backupViasNum - i - 1) * sizeof(BackupVia));
+        rNode->backupViasNum -= i + 1;
 
-    return payload;
+        SAFE_ESP_LOGW(LM_TAG, "Route %X changed from via %X to backup via %X", rNode->networkNode.address, rNode->networkNode.via, backup.via);
+
+        rNode->networkNode.via = backup.via;
+        rNode->networkNode.metric = backup.metric;
+        rNode->networkNode.cost = backup.cost;
+        rNode->timeout = backup.timeout;
+        rNode->viaFailures = 0;
+        rNode->version = ++tableVersion;
+        failoversNum++;
+
+        updateBestNodeByRole(rNode);
+
+        TrickleService::reset();
+        return true;
+    }
+
+    rNode->backupViasNum = 0;
+    return false;
 }
 
-void RoutingTableService::resetTimeoutRoutingNode(RouteNode *node)
+uint8_t RoutingTableService::getRouteCost(NetworkNode *node)
 {
-    node->timeout = millis() + DEFAULT_TIMEOUT * 1000;
+    return linkQualityRouting ? node->cost : node->metric;
 }
 
-void RoutingTableService::printRoutingTable()
+uint8_t RoutingTableService::updateLinkCost(NeighborNode *neighbor, uint8_t helloInterval, uint16_t helloSequence, int8_t receivedSNR, bool scheduled)
 {
-    SAFE_ESP_LOGI(LM_TAG, "Current routing table:");
+    if (helloInterval != 0)
+        neighbor->helloInterval = helloInterval;
 
-    routingTableList->setInUse();
+    if (!scheduled)
+        return neighbor->linkCost != 0 ? neighbor->linkCost : calculateLinkCost(neighbor->helloReceptionRatio, receivedSNR);
 
-    if (routingTableList->moveToStart())
+    uint32_t now = millis();
+
+    if (neighbor->lastHelloTime != 0)
     {
-        size_t position = 0;
+        // The hellos are numbered when they are sent, the numbers skipped since the previous one were lost.
+        // The interval changes of Trickle and the suppressed hellos do not count as losses
+        int16_t sent = (int16_t) (helloSequence - neighbor->lastHelloSequence);
 
-        do
-        {
-            RouteNode *node = routingTableList->getCurrent();
+        // A neighbor that restarted numbers its hellos from the beginning again
+        uint32_t missed = sent > 1 ? sent - 1 : 0;
 
-            SAFE_ESP_LOGI("printRoutingTable", "%d - %X via %X metric %d Role %d", position,
-                          node->networkNode.address,
-                          node->via,
-                          node->networkNode.metric,
-                          node->networkNode.role);
+        if (missed > (1 << LM_ETX_RATIO_SHIFT) * 2)
+            missed = (1 << LM_ETX_RATIO_SHIFT) * 2;
 
-            position++;
-        } while (routingTableList->next());
+        for (uint32_t i = 0; i < missed; i++)
+            neighbor->helloReceptionRatio -= neighbor->helloReceptionRatio >> LM_ETX_RATIO_SHIFT;
+
+        neighbor->helloReceptionRatio = (neighbor->helloReceptionRatio * ((1 << LM_ETX_RATIO_SHIFT) - 1) + UINT8_MAX) >> LM_ETX_RATIO_SHIFT;
     }
 
-    routingTableList->releaseInUse();
+    neighbor->lastHelloTime = now;
+    neighbor->lastHelloSequence = helloSequence;
+
+    uint8_t previousLinkCost = neighbor->linkCost;
+    neighbor->linkCost = calculateLinkCost(neighbor->helloReceptionRatio, receivedSNR);
+
+    // The neighbor only advertises its own changes, the routes through it need to follow the link
+    if (previousLinkCost != 0 && previousLinkCost != neighbor->linkCost)
+        updateRoutesCostVia(neighbor->address, previousLinkCost, neighbor->linkCost);
+
+    ESP_LOGI(LM_TAG, "Link with %X reception ratio %d, cost %d", neighbor->address, neighbor->helloReceptionRatio, neighbor->linkCost);
+
+    return neighbor->linkCost;
 }
 
-void RoutingTableService::manageTimeoutRoutingTable()
+void RoutingTableService::updateRoutesCostVia(uint16_t via, uint8_t previousLinkCost, uint8_t linkCost)
 {
-    ESP_LOGI(LM_TAG, "Checking routes timeout");
-
     routingTableList->setInUse();
 
     if (routingTableList->moveToStart())
@@ -259,27 +1149,59 @@ void RoutingTableService::manageTimeoutRoutingTable()
         {
             RouteNode *node = routingTableList->getCurrent();
 
-            if (node->timeout < millis())
-            {
-                ESP_LOGW(LM_TAG, "Route timeout %X via %X", node->networkNode.address, node->via);
+            if (node->networkNode.via != via || node->networkNode.cost == UINT8_MAX)
+                continue;
 
-                delete node;
-                routingTableList->DeleteCurrent();
-            }
+            int cost = (int) node->networkNode.cost - previousLinkCost + linkCost;
+            cost = cost < linkCost ? linkCost : (cost > UINT8_MAX ? UINT8_MAX : cost);
+
+            if (abs(cost - (int) node->networkNode.cost) >= LM_ETX_HYSTERESIS)
+                node->version = ++tableVersion;
+
+            node->networkNode.cost = cost;
+
+            updateBestNodeByRole(node);
 
         } while (routingTableList->next());
     }
 
     routingTableList->releaseInUse();
+}
 
-    printRoutingTable();
+uint8_t RoutingTableService::calculateLinkCost(uint8_t receptionRatio, int8_t snr)
+{
+    uint32_t cost = LM_ETX_MAX_LINK_COST;
+
+    if (receptionRatio > 0)
+        cost = (uint32_t) LM_ETX_SCALE * UINT8_MAX * UINT8_MAX / ((uint32_t) receptionRatio * receptionRatio);
+
+    if (snr < LM_ETX_SNR_THRESHOLD)
+        cost += (LM_ETX_SNR_THRESHOLD - snr) * LM_ETX_SNR_PENALTY;
+
+    return cost > LM_ETX_MAX_LINK_COST ? LM_ETX_MAX_LINK_COST : cost;
 }
 
-uint8_t RoutingTableService::calculateMaximumMetricOfRoutingTable()
+void RoutingTableService::updateBestNodeByRole(RouteNode *node)
 {
-    routingTableList->setInUse();
+    for (uint8_t i = 0; i < ROLE_BITS; i++)
+    {
+        if ((bestNodesByRoleValid & (1 << i)) == 0)
+            continue;
+
+        // It could be worse than another node now
+        if (isBestNodeByRole(i, node))
+            bestNodesByRoleValid &= ~(1 << i);
+        else if (node->networkNode.role & (1 << i))
+            insertBestNodeByRole(i, node);
+    }
+}
+
+void RoutingTableService::searchBestNodesByRole(uint8_t roleIndex)
+{
+    if (bestNodesByRoleValid & (1 << roleIndex))
+        return;
 
-    uint8_t maximumMetricOfRoutingTable = 0;
+    bestNodesByRoleNum[roleIndex] = 0;
 
     if (routingTableList->moveToStart())
     {
@@ -287,15 +1209,83 @@ uint8_t RoutingTableService::calculateMaximumMetricOfRoutingTable()
         {
             RouteNode *node = routingTableList->getCurrent();
 
-            if (node->networkNode.metric > maximumMetricOfRoutingTable)
-                maximumMetricOfRoutingTable = node->networkNode.metric;
+            if (node->networkNode.role & (1 << roleIndex))
+                insertBestNodeByRole(roleIndex, node);
 
         } while (routingTableList->next());
     }
 
-    routingTableList->releaseInUse();
+    bestNodesByRoleValid |= 1 << roleIndex;
+}
+
+void RoutingTableService::insertBestNodeByRole(uint8_t roleIndex, RouteNode *node)
+{
+    RouteNode **nodes = bestNodesByRole[roleIndex];
+    uint8_t &num = bestNodesByRoleNum[roleIndex];
+
+    uint8_t position = num;
+    while (position > 0 && isBetterNodeByRole(node, nodes[position - 1]))
+        position--;
+
+    if (position >= LM_UPLINK_CANDIDATES)
+        return;
+
+    if (num < LM_UPLINK_CANDIDATES)
+        num++;
+
+    memmove(&nodes[position + 1], &nodes[position], (num - 1 - position) * sizeof(RouteNode *));
+    nodes[position] = node;
+}
+
+bool RoutingTableService::isBestNodeByRole(uint8_t roleIndex, RouteNode *node)
+{
+    for (uint8_t i = 0; i < bestNodesByRoleNum[roleIndex]; i++)
+    {
+        if (bestNodesByRole[roleIndex][i] == node)
+            return true;
+    }
+
+    return false;
+}
+
+bool RoutingTableService::isBetterNodeByRole(RouteNode *node, RouteNode *bestNode)
+{
+    NetworkNode *a = &node->networkNode;
+    NetworkNode *b = &bestNode->networkNode;
+
+    // The metric and the cost break the ties of each other, then the lowest address to be deterministic
+    uint8_t firstA = getRouteCost(a), firstB = getRouteCost(b);
+    if (firstA != firstB)
+        return firstA < firstB;
+
+    uint8_t secondA = linkQualityRouting ? a->metric : a->cost;
+    uint8_t secondB = linkQualityRouting ? b->metric : b->cost;
+    if (secondA != secondB)
+        return secondA < secondB;
 
-    return maximumMetricOfRoutingTable + 1;
+    return a->address < b->address;
+}
+
+bool RoutingTableService::isHeldDown(NetworkNode *node)
+{
+    uint32_t now = millis();
+
+    for (size_t i = 0; i < LM_MAX_REMOVED_ROUTES; i++)
+    {
+        HeldDownRoute *route = &heldDownRoutes[i];
+
+        if (route->time != 0 && route->address == node->address && now - route->time < LM_ROUTE_HOLDDOWN_MS)
+            return node->metric > route->metric;
+    }
+
+    return false;
+}
+
+uint16_t RoutingTableService::getDigest(NetworkNode *node)
+{
+    uint32_t value = ((uint32_t) node->address << 16) | ((uint32_t) node->metric << 8) | node->role;
+    value *= 2654435761u;
+    return (uint16_t) (value ^ (value >> 16));
 }
 
 int RoutingTableService::createRoutingTablePacket(route_entry_t *routeTable)
@@ -328,7 +1318,7 @@ int RoutingTableService::createRoutingTablePacket(route_entry_t *routeTable)
             RouteNode *node = routingTableList->getCurrent();
 
             routeTable[routeCount].address = node->networkNode.address;
-            routeTable[routeCount].via = node->via;
+            routeTable[routeCount].via = node->networkNode.via;
             routeTable[routeCount].metric = node->networkNode.metric;
             routeTable[routeCount].role = node->networkNode.role;
 
@@ -342,4 +1332,46 @@ int RoutingTableService::createRoutingTablePacket(route_entry_t *routeTable)
     return routeCount;
 }
 
-LM_LinkedList<RouteNode> *RoutingTableService::routingTableList = new LM_LinkedList<RouteNode>();
\ No newline at end of file
+LM_LinkedList<RouteNode> *RoutingTableService::routingTableList = new LM_LinkedList<RouteNode>();
+
+LM_HashIndex<RouteNode> *RoutingTableService::routingTableIndex = new LM_HashIndex<RouteNode>(RTMAXSIZE);
+
+LM_MemoryPool *RoutingTableService::routePool = new LM_MemoryPool(sizeof(RouteNode), RTMAXSIZE);
+
+size_t RoutingTableService::capacity = RTMAXSIZE;
+
+route_eviction_e RoutingTableService::evictionPolicy = LM_ROUTE_EVICTION;
+
+uint32_t RoutingTableService::evictedRoutesNum = 0;
+
+NeighborNode RoutingTableService::neighbors[LM_MAX_NEIGHBORS];
+
+uint16_t RoutingTableService::tableVersion = 0;
+
+uint16_t RoutingTableService::advertisedVersion = 0;
+
+NetworkNode RoutingTableService::removedRoutes[LM_MAX_REMOVED_ROUTES];
+
+size_t RoutingTableService::removedRoutesNum = 0;
+
+bool RoutingTableService::fullHelloRequested = false;
+
+uint16_t RoutingTableService::fullHelloId = 0;
+
+bool RoutingTableService::linkQualityRouting = true;
+
+uint8_t RoutingTableService::routeHysteresis = LM_ETX_HYSTERESIS;
+
+uint32_t RoutingTableService::failoversNum = 0;
+
+uint32_t RoutingTableService::lastHelloTime = 0;
+
+RoutingTableService::HeldDownRoute RoutingTableService::heldDownRoutes[LM_MAX_REMOVED_ROUTES];
+
+size_t RoutingTableService::heldDownRoutesNext = 0;
+
+RouteNode *RoutingTableService::bestNodesByRole[ROLE_BITS][LM_UPLINK_CANDIDATES];
+
+uint8_t RoutingTableService::bestNodesByRoleNum[ROLE_BITS] = {0};
+
+uint8_t RoutingTableService::bestNodesByRoleValid = 0;
\ No newline at end of file
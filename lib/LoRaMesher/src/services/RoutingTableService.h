@@ -7,10 +7,16 @@
 
 #include "utilities/LinkedQueue.hpp"
 
+#include "utilities/HashIndex.hpp"
+
+#include "utilities/MemoryPool.hpp"
+
 #include "entities/routingTable/RouteNode.h"
 
 #include "entities/routingTable/NetworkNode.h"
 
+#include "entities/routingTable/NeighborNode.h"
+
 #include "entities/packets/RoutePacket.h"
 
 #include "BuildOptions.h"
@@ -34,7 +40,7 @@ public:
 		uint8_t role;
 	} route_entry_t;
 
-	static special_addr_e decideHowToSendData(void)
+	static special_addr_e decideHowToSendData(uint16_t src)
 	{
 		uint8_t myRole = RoleService::getRole();
 		WiFiTransmitter &wifi = WiFiTransmitter::getInstance();
@@ -46,10 +52,10 @@ public:
 		}
 
 		// 2. 路由表有CLIENT
-		RouteNode *bestClient = getBestNodeByRole(ROLE_CLIENT);
-		if (bestClient != nullptr)
+		uint16_t bestClient = getUplinkNodeByRole(ROLE_CLIENT, src);
+		if (bestClient != 0)
 		{
-			return static_cast<special_addr_e>(bestClient->networkNode.address);
+			return static_cast<special_addr_e>(bestClient);
 		}
 
 		// 3. 没有CLIENT，自己是GATEWAY（4G）
@@ -59,10 +65,10 @@ public:
 		}
 
 		// 4. 路由表有GATEWAY（4G）
-		RouteNode *bestGateway = getBestNodeByRole(ROLE_GATEWAY);
-		if (bestGateway != nullptr)
+		uint16_t bestGateway = getUplinkNodeByRole(ROLE_GATEWAY, src);
+		if (bestGateway != 0)
 		{
-			return static_cast<special_addr_e>(bestGateway->networkNode.address);
+			return static_cast<special_addr_e>(bestGateway);
 		}
 
 		// 5. 都没有
@@ -76,6 +82,17 @@ public:
 	 */
 	static LM_LinkedList<RouteNode> *routingTableList;
 
+	/**
+	 * @brief Initialize the route selection and the routing table. If the capacity changes, the routes are moved to a new
+	 * pool and, if they do not fit, the worse ones to keep are removed and advertised as unreachable
+	 *
+	 * @param linkQuality Select the routes by their cost instead of the number of hops
+	 * @param hysteresis Cost improvement needed to change the next hop of a route
+	 * @param capacity Maximum number of routes
+	 * @param eviction Route replaced when the routing table is full
+	 */
+	static void init(bool linkQuality, uint8_t hysteresis, size_t capacity, route_eviction_e eviction);
+
 	/**
 	 * @brief Prints the actual routing table in the log
 	 *
@@ -89,6 +106,42 @@ public:
 	 */
 	static NetworkNode *getAllNetworkNodes();
 
+	/**
+	 * @brief Get the Network Nodes that need to be sent in the next hello. Only the routes changed or removed
+	 * since the previous hello are returned, unless a full hello is needed. After calling it, the changes are
+	 * considered advertised.
+	 *
+	 * @param full If true returns all the nodes. It is set to true if a full hello has been requested
+	 * @param numNodes Number of nodes returned
+	 * @param baseVersion Routing table version the changes are based on
+	 * @param version Routing table version after the changes
+	 * @param digest Digest of the whole routing table
+	 * @return NetworkNode* Nodes to be sent or nullptr if there are no nodes. It needs to be deleted with delete[]
+	 */
+	static NetworkNode *getHelloNetworkNodes(bool &full, size_t &numNodes, uint16_t &baseVersion, uint16_t &version, uint16_t &digest);
+
+	/**
+	 * @brief Returns if a neighbor asked for a full hello or if the removed routes could not be remembered
+	 *
+	 * @return true If the next hello needs to be a full hello
+	 */
+	static bool isFullHelloRequested();
+
+	/**
+	 * @brief Returns if the routing table changed since the last hello, so the next hello can not be suppressed
+	 *
+	 * @return true If there are changes to be sent
+	 */
+	static bool hasHelloChanges();
+
+	/**
+	 * @brief Get the time until the removed routes can be advertised with a triggered hello. The triggered
+	 * hellos are sent at least LM_TRIGGERED_HELLO_MIN_MS after the previous hello
+	 *
+	 * @return uint32_t Time in ms, 0 if it needs to be sent now or UINT32_MAX if there are no removed routes
+	 */
+	static uint32_t getTimeUntilTriggeredHello();
+
 	/**
 	 * @brief Find the node that contains the address
 	 *
@@ -105,6 +158,17 @@ public:
 	 */
 	static RouteNode *getBestNodeByRole(uint8_t role);
 
+	/**
+	 * @brief Get the node the data of a source is sent to, between the LM_UPLINK_CANDIDATES best nodes with the role.
+	 * The traffic of the different sources is balanced by their route cost and the uplink load they advertise.
+	 * The nodes at LM_UPLINK_LOAD_MAX are skipped while another candidate can take the traffic
+	 *
+	 * @param role Single role, ROLE_CLIENT or ROLE_GATEWAY
+	 * @param src Source of the data
+	 * @return uint16_t Address of the node or 0 if there is no node with the role
+	 */
+	static uint16_t getUplinkNodeByRole(uint8_t role, uint16_t src);
+
 	/**
 	 * @brief Returns if address is inside the routing table
 	 *
@@ -115,13 +179,57 @@ public:
 	static bool hasAddressRoutingTable(uint16_t address);
 
 	/**
-	 * @brief Get the Next Hop address
+	 * @brief Get the Next Hop address. If the next hop is stale, the route changes to the best backup next hop
 	 *
 	 * @param dst address of the next hop
 	 * @return uint16_t address of the next hop
 	 */
 	static uint16_t getNextHop(uint16_t dst);
 
+	/**
+	 * @brief A reliable payload to the destination timed out. After LM_VIA_MAX_FAILURES the route changes
+	 * to the best backup next hop
+	 *
+	 * @param dst Destination address
+	 */
+	static void reportNextHopFailure(uint16_t dst);
+
+	/**
+	 * @brief A reliable payload to the destination has been acknowledged, the next hop works
+	 *
+	 * @param dst Destination address
+	 */
+	static void reportNextHopSuccess(uint16_t dst);
+
+	/**
+	 * @brief Get the number of routes that changed to a backup next hop
+	 *
+	 * @return uint32_t
+	 */
+	static uint32_t getFailoversNum() { return failoversNum; }
+
+	/**
+	 * @brief Get the number of routes replaced by new ones because the routing table was full
+	 *
+	 * @return uint32_t
+	 */
+	static uint32_t getEvictedRoutesNum() { return evictedRoutesNum; }
+
+	/**
+	 * @brief Get the maximum number of routes
+	 *
+	 * @return size_t
+	 */
+	static size_t getCapacity() { return capacity; }
+
+	/**
+	 * @brief Get the bytes reserved for the routing table: the routes, their index and the neighbors.
+	 * The list nodes come from the list node pool
+	 *
+	 * @return size_t
+	 */
+	static size_t getMemory();
+
 	/**
 	 * @brief Get the Number Of Hops of the address inside the routing table
 	 *
@@ -131,25 +239,42 @@ public:
 	static uint8_t getNumberOfHops(uint16_t address);
 
 	/**
-	 * @brief Returns the routing table size
+	 * @brief Get the round-trip time estimation of the route to an address
 	 *
-	 * @return size_t
+	 * @param address Address of the route
+	 * @param SRTT Smoothed round-trip time in ms, 0 if it has not been calculated yet
+	 * @param RTTVAR Round-trip time variation in ms
+	 * @return uint8_t Number of Hops or 0 if address not found in routing table.
 	 */
-	static size_t routingTableSize();
+	static uint8_t getRouteRTT(uint16_t address, unsigned long &SRTT, unsigned long &RTTVAR);
 
 	/**
-	 * @brief Process the network packet
+	 * @brief Add a round-trip time measure to the estimation of the route to an address (RFC 6298)
 	 *
-	 * @param p Route Packet
+	 * @param address Address of the route
+	 * @param RTT Round-trip time measured in ms
+	 * @param SRTT Smoothed round-trip time in ms after the update
+	 * @param RTTVAR Round-trip time variation in ms after the update
+	 * @return true If the address is inside the routing table
+	 */
+	static bool updateRouteRTT(uint16_t address, unsigned long RTT, unsigned long &SRTT, unsigned long &RTTVAR);
+
+	/**
+	 * @brief Returns the routing table size
+	 *
+	 * @return size_t
 	 */
+	static size_t routingTableSize();
 
 	/**
-	 * @brief Process the network packet
+	 * @brief Process the network packet. Full hellos replace the routes via the sender, other hellos
+	 * only contain the changes since the version we already have of the sender.
 	 *
 	 * @param p Route Packet
 	 * @param receivedSNR Received SNR
+	 * @return true If we are not synchronized with the sender and a full hello needs to be requested
 	 */
-	static void processRoute(RoutePacket *p, int8_t receivedSNR);
+	static bool processRoute(RoutePacket *p, int8_t receivedSNR);
 
 	/**
 	 * @brief Reset the SNR from the Route Node received
@@ -181,13 +306,233 @@ public:
 	static int createRoutingTablePacket(route_entry_t *routeTable);
 
 private:
+	/**
+	 * @brief Index by address of the nodes inside the routing table list. Protected by the routing table list semaphore
+	 *
+	 */
+	static LM_HashIndex<RouteNode> *routingTableIndex;
+
+	/**
+	 * @brief Pool of the route nodes, one block for each route of the capacity
+	 *
+	 */
+	static LM_MemoryPool *routePool;
+
+	/**
+	 * @brief Maximum number of routes
+	 *
+	 */
+	static size_t capacity;
+
+	/**
+	 * @brief Route replaced when the routing table is full
+	 *
+	 */
+	static route_eviction_e evictionPolicy;
+
+	/**
+	 * @brief Number of routes replaced by new ones because the routing table was full
+	 *
+	 */
+	static uint32_t evictedRoutesNum;
+
+	/**
+	 * @brief Link state of the neighbors, free entries have the address 0. Protected by the routing table list semaphore
+	 *
+	 */
+	static NeighborNode neighbors[LM_MAX_NEIGHBORS];
+
+	/**
+	 * @brief Find a neighbor. The routing table list needs to be in use
+	 *
+	 * @param address Address of the neighbor
+	 * @return NeighborNode* The neighbor or nullptr
+	 */
+	static NeighborNode *findNeighbor(uint16_t address);
+
+	/**
+	 * @brief Get the neighbor that sent a hello, adding it if it is new, and reset its timeout. If there is no
+	 * space, the neighbor heard for the last time the longest ago is replaced
+	 *
+	 * @param address Address of the neighbor
+	 * @param timeout Timeout of the neighbor in ms
+	 * @return NeighborNode* The neighbor
+	 */
+	static NeighborNode *addNeighbor(uint16_t address, uint32_t timeout);
+
+	/**
+	 * @brief Create a route node inside the route pool
+	 *
+	 * @return RouteNode* The route node or nullptr if the pool is empty
+	 */
+	static RouteNode *createRouteNode(NetworkNode *node, uint16_t via);
+
+	/**
+	 * @brief Delete a route node and return it to the route pool
+	 *
+	 * @param node Route node
+	 */
+	static void deleteRouteNode(RouteNode *node);
+
+	/**
+	 * @brief Remove a route to make space for a new one, following the eviction policy. The routes used to send
+	 * in the last LM_ROUTE_ACTIVE_S seconds are not removed. The routing table list needs to be in use
+	 *
+	 * @param node Network node of the new route
+	 * @return true If a route has been removed
+	 */
+	static bool evictRoute(NetworkNode *node);
+
+	/**
+	 * @brief Returns if a route needs to be removed before another one, following the eviction policy
+	 *
+	 * @param node Route node
+	 * @param victim Actual route to be removed
+	 */
+	static bool isWorseToKeep(RouteNode *node, RouteNode *victim);
+
+	/**
+	 * @brief Get the time since a route was used to send, wrap-around safe
+	 *
+	 * @param node Route node
+	 * @return uint32_t Time in ms, UINT32_MAX if it has never been used
+	 */
+	static uint32_t getIdleTime(RouteNode *node);
+
+	/**
+	 * @brief Routing table version, incremented every time a route is added, changed or removed
+	 *
+	 */
+	static uint16_t tableVersion;
+
+	/**
+	 * @brief Routing table version sent in the last hello
+	 *
+	 */
+	static uint16_t advertisedVersion;
+
+	/**
+	 * @brief Routes removed since the last hello, sent with LM_UNREACHABLE_METRIC
+	 *
+	 */
+	static NetworkNode removedRoutes[LM_MAX_REMOVED_ROUTES];
+
+	static size_t removedRoutesNum;
+
+	/**
+	 * @brief The next hello needs to be a full hello
+	 *
+	 */
+	static bool fullHelloRequested;
+
+	/**
+	 * @brief Identifier of the last full hello being received
+	 *
+	 */
+	static uint16_t fullHelloId;
+
+	/**
+	 * @brief Time in ms of the last hello created
+	 *
+	 */
+	static uint32_t lastHelloTime;
+
+	/**
+	 * @brief Route removed recently
+	 *
+	 */
+	struct HeldDownRoute {
+		uint16_t address;
+		uint8_t metric;
+		uint32_t time;
+	};
+
+	/**
+	 * @brief Routes removed in the last LM_ROUTE_HOLDDOWN_MS, the oldest one is replaced
+	 *
+	 */
+	static HeldDownRoute heldDownRoutes[LM_MAX_REMOVED_ROUTES];
+
+	/**
+	 * @brief Next position of heldDownRoutes to be replaced
+	 *
+	 */
+	static size_t heldDownRoutesNext;
+
+	/**
+	 * @brief Best nodes of each single role, the best one first, indexed by the bit of the role. A removed route
+	 * is never kept inside, the roles it was in are emptied and searched again
+	 *
+	 */
+	static RouteNode *bestNodesByRole[ROLE_BITS][LM_UPLINK_CANDIDATES];
+
+	/**
+	 * @brief Number of best nodes of each role
+	 *
+	 */
+	static uint8_t bestNodesByRoleNum[ROLE_BITS];
+
+	/**
+	 * @brief Bits of the roles whose best nodes are cached
+	 *
+	 */
+	static uint8_t bestNodesByRoleValid;
+
+	/**
+	 * @brief Update the best nodes by role after a change of the route. If it was one of the best nodes of a role and
+	 * it could be worse now, the role is searched again in the next query. The routing table list needs to be in use
+	 *
+	 * @param node Route node changed or added
+	 */
+	static void updateBestNodeByRole(RouteNode *node);
+
+	/**
+	 * @brief Search the best nodes of a role if they are not cached. The routing table list needs to be in use
+	 *
+	 * @param roleIndex Bit of the role
+	 */
+	static void searchBestNodesByRole(uint8_t roleIndex);
+
+	/**
+	 * @brief Insert a node in its position of the best nodes of a role, if it is one of them
+	 *
+	 * @param roleIndex Bit of the role
+	 * @param node Route node
+	 */
+	static void insertBestNodeByRole(uint8_t roleIndex, RouteNode *node);
+
+	/**
+	 * @brief Returns if the node is one of the best nodes of a role
+	 *
+	 * @param roleIndex Bit of the role
+	 * @param node Route node
+	 */
+	static bool isBestNodeByRole(uint8_t roleIndex, RouteNode *node);
+
+	/**
+	 * @brief Returns if a node is better than another one to be chosen by its role
+	 *
+	 * @param node Route node
+	 * @param bestNode Actual best route node
+	 */
+	static bool isBetterNodeByRole(RouteNode *node, RouteNode *bestNode);
+
+	/**
+	 * @brief Returns if a new route needs to be ignored because a better route to the same address has
+	 * been removed recently
+	 *
+	 * @param node Network node of the new route
+	 */
+	static bool isHeldDown(NetworkNode *node);
+
 	/**
 	 * @brief process the network node, adds the node in the routing table if can
 	 *
 	 * @param via via address
 	 * @param node NetworkNode
+	 * @param timeout Timeout of the route in ms
 	 */
-	static void processRoute(uint16_t via, NetworkNode *node);
+	static void processRoute(uint16_t via, NetworkNode *node, uint32_t timeout);
 
 	/**
 	 * @brief process the network node, adds the node in the routing table if can
@@ -202,30 +547,168 @@ private:
 	 * @brief Reset the timeout of the given node
 	 *
 	 * @param node node to be reset the timeout
+	 * @param timeout Timeout in ms
 	 */
-	static void resetTimeoutRoutingNode(RouteNode *node);
+	static void resetTimeoutRoutingNode(RouteNode *node, uint32_t timeout);
 
 	/**
-	 * @brief Add node to the routing table
+	 * @brief Add node to the routing table. The routing table list needs to be in use
 	 *
 	 * @param node Network node that includes the address and the metric
 	 * @param via Address to next hop to reach the network node address
+	 * @param timeout Timeout of the route in ms
 	 */
+	static void addNodeToRoutingTable(NetworkNode *node, uint16_t via, uint32_t timeout);
 
 	/**
-	 * @brief Add node to the routing table
+	 * @brief Remove the route to the address, only if the next hop is via
 	 *
-	 * @param node Network node that includes the address and the metric
-	 * @param via Address to next hop to reach the network node address
+	 * @param address Address of the route
+	 * @param via Next hop that removed the route
+	 */
+	static void removeRoute(uint16_t address, uint16_t via);
+
+	/**
+	 * @brief Remove the routes via the given neighbor that were not inside its last full hello
+	 *
+	 * @param via Address of the neighbor
+	 * @param helloId Identifier of the full hello
+	 */
+	static void removeStaleRoutes(uint16_t via, uint16_t helloId);
+
+	/**
+	 * @brief Reset the timeout of all the routes via the given neighbor
+	 *
+	 * @param via Address of the neighbor
+	 * @param timeout Timeout in ms
+	 */
+	static void resetTimeoutRoutesVia(uint16_t via, uint32_t timeout);
+
+	/**
+	 * @brief Returns if a full hello can be requested to the neighbor, the requests are limited to one each hello period
+	 *
+	 * @param neighbor Neighbor
+	 */
+	static bool canRequestFullHello(NeighborNode *neighbor);
+
+	/**
+	 * @brief Increment the routing table version and mark the node as changed. The routing table list needs to be in use
+	 *
+	 * @param node Route node changed
+	 */
+	static void routeChanged(RouteNode *node);
+
+	/**
+	 * @brief Increment the routing table version, remember the removed route for the next hello and
+	 * reset the hello interval. The routing table list needs to be in use
+	 *
+	 * @param node Route node removed, it is deleted afterwards
+	 */
+	static void routeRemoved(RouteNode *node);
+
+	/**
+	 * @brief Select the routes by their cost instead of the number of hops
+	 *
+	 */
+	static bool linkQualityRouting;
+
+	/**
+	 * @brief Cost improvement needed to change the next hop of a route
+	 *
+	 */
+	static uint8_t routeHysteresis;
+
+	/**
+	 * @brief Number of routes that changed to a backup next hop
+	 *
+	 */
+	static uint32_t failoversNum;
+
+	/**
+	 * @brief Add or update an alternative next hop of a route, keeping them ranked by their cost.
+	 * If there is no space, the worst one is discarded
+	 *
+	 * @param rNode Route node
+	 * @param via Alternative next hop
+	 * @param metric Metric through the alternative next hop
+	 * @param cost Cost through the alternative next hop
+	 * @param timeout Time in ms when the alternative next hop expires
+	 */
+	static void addBackupVia(RouteNode *rNode, uint16_t via, uint8_t metric, uint8_t cost, uint32_t timeout);
+
+	/**
+	 * @brief Remove an alternative next hop of a route
+	 *
+	 * @param rNode Route node
+	 * @param via Alternative next hop
+	 */
+	static void removeBackupVia(RouteNode *rNode, uint16_t via);
+
+	/**
+	 * @brief Returns if a next hop has not sent its hellos. A next hop that is not inside the neighbors is not stale.
+	 * The routing table list needs to be in use
+	 *
+	 * @param via Address of the next hop
+	 */
+	static bool isViaStale(uint16_t via);
+
+	/**
+	 * @brief Replace the next hop of a route with the best backup one that is not expired nor stale.
+	 * The routing table list needs to be in use
+	 *
+	 * @param rNode Route node
+	 * @return true If the next hop has been replaced
+	 */
+	static bool failover(RouteNode *rNode);
+
+	/**
+	 * @brief Get the value used to compare the routes, the cost or the number of hops
+	 *
+	 * @param node Network node
+	 * @return uint8_t Value, lower is better
+	 */
+	static uint8_t getRouteCost(NetworkNode *node);
+
+	/**
+	 * @brief Update the hello reception ratio of a neighbor with a new hello and get the cost of its link.
+	 * The hellos missed are the numbers skipped since the previous hello received
+	 *
+	 * @param neighbor Neighbor
+	 * @param helloInterval Hello interval of the neighbor in seconds, 0 if unknown
+	 * @param helloSequence Number of the hello
+	 * @param receivedSNR Received SNR
+	 * @param scheduled If it is the first packet of a hello, the others do not update the ratio
+	 * @return uint8_t Cost of the link
+	 */
+	static uint8_t updateLinkCost(NeighborNode *neighbor, uint8_t helloInterval, uint16_t helloSequence, int8_t receivedSNR, bool scheduled);
+
+	/**
+	 * @brief Apply the change of the cost of a link to the routes through it. The changes greater than the
+	 * hysteresis are advertised
+	 *
+	 * @param via Address of the neighbor
+	 * @param previousLinkCost Previous cost of the link
+	 * @param linkCost New cost of the link
+	 */
+	static void updateRoutesCostVia(uint16_t via, uint8_t previousLinkCost, uint8_t linkCost);
+
+	/**
+	 * @brief Calculate the cost of a link, ETX = 1 / ratio^2 plus the SNR penalty
+	 *
+	 * @param receptionRatio Ratio of the hellos received, 255 is all of them
+	 * @param snr SNR of the link
+	 * @return uint8_t Cost in 1/LM_ETX_SCALE expected transmissions
 	 */
-	static void addNodeToRoutingTable(NetworkNode *node, uint16_t via);
+	static uint8_t calculateLinkCost(uint8_t receptionRatio, int8_t snr);
 
 	/**
-	 * @brief Get the Maximum Metric Of Routing Table. To prevent that some new entries are not added to the routing table.
+	 * @brief Get the digest of a network node. The digest of the routing table is the sum of all of them,
+	 * so it does not depend on the order of the routes. The cost is not included, its small changes are not advertised
 	 *
-	 * @return uint8_t Returns the maximum metric of the routing table
+	 * @param node Network node
+	 * @return uint16_t Digest
 	 */
-	static uint8_t calculateMaximumMetricOfRoutingTable();
+	static uint16_t getDigest(NetworkNode *node);
 };
 
 #endif
\ No newline at end of file
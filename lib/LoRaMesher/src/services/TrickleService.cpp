@@ -0,0 +1,132 @@
+#include "TrickleService.h"
+
+void TrickleService::init(uint32_t intervalMin, uint8_t doublings, uint8_t redundancy) {
+    if (intervalMin == 0)
+        intervalMin = 1000;
+
+    // The hellos advertise the interval in seconds in one byte, the receivers expire the routes with it
+    if (intervalMin > LM_TRICKLE_IMAX_MS)
+        intervalMin = LM_TRICKLE_IMAX_MS;
+
+    if (doublings > 16)
+        doublings = 16;
+
+    uint64_t maxInterval = (uint64_t) intervalMin << doublings;
+
+    portENTER_CRITICAL(&mux);
+
+    TrickleService::intervalMin = intervalMin;
+    TrickleService::intervalMax = maxInterval > LM_TRICKLE_IMAX_MS ? LM_TRICKLE_IMAX_MS : maxInterval;
+    TrickleService::redundancy = redundancy;
+    interval = intervalMin;
+    suppressed = false;
+    startInterval(millis());
+
+    portEXIT_CRITICAL(&mux);
+}
+
+void TrickleService::setHelloTask(TaskHandle_t task) {
+    helloTask = task;
+}
+
+void TrickleService::startInterval(uint32_t now) {
+    intervalStart = now;
+    counter = 0;
+    sendTimeProcessed = false;
+    sendTime = interval / 2 + random(0, interval / 2);
+}
+
+void TrickleService::reset() {
+    bool restarted = false;
+
+    portENTER_CRITICAL(&mux);
+
+    // Already at the minimum interval, nothing to do
+    if (interval != intervalMin) {
+        interval = intervalMin;
+        startInterval(millis());
+        restarted = true;
+    }
+
+    portEXIT_CRITICAL(&mux);
+
+    if (restarted && helloTask != nullptr)
+        xTaskNotifyGive(helloTask);
+}
+
+void TrickleService::hearConsistent() {
+    portENTER_CRITICAL(&mux);
+
+    if (counter < UINT8_MAX)
+        counter++;
+
+    portEXIT_CRITICAL(&mux);
+}
+
+uint32_t TrickleService::getTimeUntilNextEvent() {
+    portENTER_CRITICAL(&mux);
+
+    uint32_t elapsed = millis() - intervalStart;
+    uint32_t event = sendTimeProcessed ? interval : sendTime;
+
+    portEXIT_CRITICAL(&mux);
+
+    return elapsed >= event ? 0 : event - elapsed;
+}
+
+bool TrickleService::process(bool mustSend) {
+    bool send = false;
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&mux);
+
+    if (now - intervalStart >= interval) {
+        interval = interval * 2 > intervalMax ? intervalMax : interval * 2;
+        startInterval(now);
+    }
+
+    if (!sendTimeProcessed && now - intervalStart >= sendTime) {
+        sendTimeProcessed = true;
+
+        // Never suppress two hellos in a row, the neighbors use them to keep our routes
+        send = mustSend || redundancy == 0 || counter < redundancy || suppressed;
+        suppressed = !send;
+    }
+    else if (mustSend) {
+        // Sent before its time, it counts as the hello of this interval
+        sendTimeProcessed = true;
+        suppressed = false;
+        send = true;
+    }
+
+    portEXIT_CRITICAL(&mux);
+
+    return send;
+}
+
+uint8_t TrickleService::getIntervalSeconds() {
+    uint32_t seconds = (interval + 999) / 1000;
+    return seconds > UINT8_MAX ? UINT8_MAX : seconds;
+}
+
+uint32_t TrickleService::intervalMin = 1000;
+
+uint32_t TrickleService::intervalMax = 1000;
+
+uint8_t TrickleService::redundancy = 0;
+
+uint32_t TrickleService::interval = 1000;
+
+uint32_t TrickleService::intervalStart = 0;
+
+uint32_t TrickleService::sendTime = 0;
+
+uint8_t TrickleService::counter = 0;
+
+bool TrickleService::sendTimeProcessed = false;
+
+bool TrickleService::suppressed = false;
+
+TaskHandle_t TrickleService::helloTask = nullptr;
+
+portMUX_TYPE TrickleService::mux = portMUX_INITIALIZER_UNLOCKED;
@@ -0,0 +1,96 @@
+#ifndef _LORAMESHER_TRICKLE_SERVICE_H
+#define _LORAMESHER_TRICKLE_SERVICE_H
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Trickle Service (RFC 6206). Decides when the hello packets are sent. The interval doubles every time
+ * it ends, until the maximum interval, while the routing table is consistent. When an inconsistency is found,
+ * the interval is reset to the minimum one. Inside each interval the hello is sent at a random time in the
+ * second half of the interval, and it is suppressed if enough consistent hellos have been heard.
+ *
+ */
+class TrickleService {
+public:
+    /**
+     * @brief Initialize the Trickle Service and start the first interval
+     *
+     * @param intervalMin Minimum interval in ms
+     * @param doublings Number of times the minimum interval can be doubled, the interval is LM_TRICKLE_IMAX_MS at most
+     * @param redundancy Consistent hellos heard inside an interval that suppress our hello. 0 disables the suppression
+     */
+    static void init(uint32_t intervalMin, uint8_t doublings, uint8_t redundancy);
+
+    /**
+     * @brief Set the task that sends the hello packets, it is notified when the interval is reset
+     *
+     * @param task Task handle
+     */
+    static void setHelloTask(TaskHandle_t task);
+
+    /**
+     * @brief An inconsistency has been found, start again with the minimum interval
+     *
+     */
+    static void reset();
+
+    /**
+     * @brief A consistent hello has been heard
+     *
+     */
+    static void hearConsistent();
+
+    /**
+     * @brief Get the time in ms until the hello needs to be sent or the interval ends
+     *
+     * @return uint32_t
+     */
+    static uint32_t getTimeUntilNextEvent();
+
+    /**
+     * @brief Process the events that are due, ending the interval if needed
+     *
+     * @param mustSend The hello can not be suppressed, for example because it contains changes
+     * @return true If the hello needs to be sent now
+     */
+    static bool process(bool mustSend);
+
+    /**
+     * @brief Get the current interval in seconds, rounded up
+     *
+     * @return uint8_t
+     */
+    static uint8_t getIntervalSeconds();
+
+private:
+    /**
+     * @brief Start a new interval. Needs to be called inside the critical section
+     *
+     * @param now Current time in ms
+     */
+    static void startInterval(uint32_t now);
+
+    static uint32_t intervalMin;
+
+    static uint32_t intervalMax;
+
+    static uint8_t redundancy;
+
+    static uint32_t interval;
+
+    static uint32_t intervalStart;
+
+    static uint32_t sendTime;
+
+    static uint8_t counter;
+
+    static bool sendTimeProcessed;
+
+    static bool suppressed;
+
+    static TaskHandle_t helloTask;
+
+    static portMUX_TYPE mux;
+};
+
+#endif
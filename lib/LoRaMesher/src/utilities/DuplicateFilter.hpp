@@ -0,0 +1,121 @@
+#pragma once
+
+#include <math.h>
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Time bounded set of 32 bit fingerprints, made of two Bloom filters. New fingerprints are added
+ * to the current filter and both are checked. When the current filter is full or older than the
+ * generation time the older one is cleared and becomes the current one, so a fingerprint is remembered
+ * between one and two generations. It is not thread safe, the owner needs to protect it.
+ *
+ */
+class LM_DuplicateFilter {
+private:
+    uint8_t* filters[2];
+    size_t bits;
+    size_t mask;
+    uint8_t hashes;
+    uint8_t current;
+    size_t capacity;
+    size_t inserted;
+    uint32_t generationTime;
+    uint32_t generationStart;
+
+    bool contains(uint8_t filter, uint32_t fingerprint) const {
+        // Double hashing, the second hash needs to be odd to visit different bits
+        uint32_t h2 = ((fingerprint >> 16) | (fingerprint << 16)) * 2654435769u | 1;
+
+        for (uint8_t i = 0; i < hashes; i++) {
+            size_t bit = (fingerprint + i * h2) & mask;
+            if ((filters[filter][bit / 8] & (1 << (bit % 8))) == 0)
+                return false;
+        }
+
+        return true;
+    }
+
+    void insert(uint8_t filter, uint32_t fingerprint) {
+        uint32_t h2 = ((fingerprint >> 16) | (fingerprint << 16)) * 2654435769u | 1;
+
+        for (uint8_t i = 0; i < hashes; i++) {
+            size_t bit = (fingerprint + i * h2) & mask;
+            filters[filter][bit / 8] |= 1 << (bit % 8);
+        }
+    }
+
+    void rotate(uint32_t now) {
+        current ^= 1;
+        memset(filters[current], 0, bits / 8);
+        inserted = 0;
+        generationStart = now;
+    }
+
+public:
+    /**
+     * @brief Construct a new duplicate filter
+     *
+     * @param capacity Fingerprints inside each generation
+     * @param falsePositiveRate False positive rate of each filter when it is full, between 0 and 1
+     * @param generationTime Time in ms of each generation
+     */
+    LM_DuplicateFilter(size_t capacity, float falsePositiveRate, uint32_t generationTime)
+        : current(0), capacity(capacity == 0 ? 1 : capacity), inserted(0), generationTime(generationTime), generationStart(0) {
+        if (falsePositiveRate <= 0 || falsePositiveRate >= 1)
+            falsePositiveRate = 0.01;
+
+        // Optimal size m = -n ln(p) / ln(2)^2, rounded up to a power of two
+        float optimalBits = -(float) this->capacity * logf(falsePositiveRate) / (M_LN2 * M_LN2);
+        bits = 8;
+        while (bits < optimalBits)
+            bits <<= 1;
+
+        mask = bits - 1;
+
+        // Optimal number of hashes k = m / n ln(2)
+        float optimalHashes = (float) bits / this->capacity * M_LN2;
+        hashes = optimalHashes < 1 ? 1 : (optimalHashes > 16 ? 16 : (uint8_t) roundf(optimalHashes));
+
+        filters[0] = new uint8_t[bits / 8]();
+        filters[1] = new uint8_t[bits / 8]();
+    }
+
+    ~LM_DuplicateFilter() {
+        delete[] filters[0];
+        delete[] filters[1];
+    }
+
+    /**
+     * @brief Check if the fingerprint has been seen and add it
+     *
+     * @param fingerprint Fingerprint
+     * @param now Actual time in ms
+     * @return true If it has been seen in the last generations, or a false positive
+     * @return false If it is new
+     */
+    bool CheckAndInsert(uint32_t fingerprint, uint32_t now) {
+        if (now - generationStart >= generationTime || inserted >= capacity)
+            rotate(now);
+
+        if (contains(0, fingerprint) || contains(1, fingerprint))
+            return true;
+
+        insert(current, fingerprint);
+        inserted++;
+        return false;
+    }
+
+    void Clear() {
+        memset(filters[0], 0, bits / 8);
+        memset(filters[1], 0, bits / 8);
+        inserted = 0;
+    }
+
+    /**
+     * @brief Bytes used by the filters
+     */
+    size_t getMemory() const { return bits / 4; }
+
+    uint8_t getHashes() const { return hashes; }
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Open addressing hash index that maps a 16 bit address to an element.
+ * Uses linear probing and backward shift deletion, so no tombstones are needed.
+ * It does not own the elements and it is not thread safe, the owner needs to protect it.
+ *
+ * @tparam T Type of the elements
+ */
+template <class T>
+class LM_HashIndex {
+private:
+    struct Slot {
+        uint16_t key;
+        T* element;
+    };
+
+    Slot* slots;
+    size_t capacity;
+    size_t mask;
+    uint8_t shift;
+    size_t length;
+
+    size_t hash(uint16_t key) const;
+public:
+    LM_HashIndex(size_t maxElements);
+    ~LM_HashIndex();
+    T* Find(uint16_t key) const;
+    bool Insert(uint16_t key, T* element);
+    bool Remove(uint16_t key);
+    size_t getLength() { return length; }
+    size_t getMemory() const { return capacity * sizeof(Slot); }
+    void Clear();
+};
+
+template <class T>
+LM_HashIndex<T>::LM_HashIndex(size_t maxElements) : length(0) {
+    // Keep the load factor at or below 50%
+    capacity = 2;
+    shift = 31;
+    while (capacity < maxElements * 2) {
+        capacity <<= 1;
+        shift--;
+    }
+
+    mask = capacity - 1;
+    slots = new Slot[capacity];
+    Clear();
+}
+
+template <class T>
+LM_HashIndex<T>::~LM_HashIndex() {
+    delete[] slots;
+}
+
+template <class T>
+size_t LM_HashIndex<T>::hash(uint16_t key) const {
+    // Fibonacci hashing, addresses are usually consecutive or share the same high bits
+    return ((uint32_t) key * 2654435769u) >> shift;
+}
+
+template <class T>
+T* LM_HashIndex<T>::Find(uint16_t key) const {
+    size_t i = hash(key);
+
+    while (slots[i].element != nullptr) {
+        if (slots[i].key == key)
+            return slots[i].element;
+
+        i = (i + 1) & mask;
+    }
+
+    return nullptr;
+}
+
+template <class T>
+bool LM_HashIndex<T>::Insert(uint16_t key, T* element) {
+    size_t i = hash(key);
+
+    while (slots[i].element != nullptr) {
+        if (slots[i].key == key) {
+            slots[i].element = element;
+            return true;
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    if (length >= capacity - 1)
+        return false;
+
+    slots[i].key = key;
+    slots[i].element = element;
+    length++;
+    return true;
+}
+
+template <class T>
+bool LM_HashIndex<T>::Remove(uint16_t key) {
+    size_t i = hash(key);
+
+    while (slots[i].element != nullptr && slots[i].key != key)
+        i = (i + 1) & mask;
+
+    if (slots[i].element == nullptr)
+        return false;
+
+    // Backward shift the following elements of the cluster into the hole
+    size_t hole = i;
+    size_t j = i;
+
+    for (;;) {
+        j = (j + 1) & mask;
+        if (slots[j].element == nullptr)
+            break;
+
+        size_t home = hash(slots[j].key);
+
+        // Move it only if its home position is not between the hole and j (cyclically)
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            slots[hole] = slots[j];
+            hole = j;
+        }
+    }
+
+    slots[hole].element = nullptr;
+    length--;
+    return true;
+}
+
+template <class T>
+void LM_HashIndex<T>::Clear() {
+    for (size_t i = 0; i < capacity; i++)
+        slots[i].element = nullptr;
+
+    length = 0;
+}
@@ -4,6 +4,8 @@
 
 #include "BuildOptions.h"
 
+#include "services/MemoryPoolService.h"
+
 template <class T>
 class LM_ListNode {
 public:
@@ -14,6 +16,14 @@ public:
     LM_ListNode(T* element, LM_ListNode* prev, LM_ListNode* next)
         : element(element), prev(prev), next(next) {
     };
+
+    void* operator new(size_t size) {
+        return MemoryPoolService::allocateListNode(size);
+    }
+
+    void operator delete(void* p) {
+        MemoryPoolService::freeListNode(p);
+    }
 };
 
 template <class T>
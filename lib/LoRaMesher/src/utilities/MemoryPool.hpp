@@ -0,0 +1,138 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Fixed size block allocator. All the blocks are reserved in a single allocation
+ * and the free blocks are kept in an intrusive free list, so allocate and free are O(1)
+ * and they do not fragment the heap.
+ *
+ */
+class LM_MemoryPool {
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    uint8_t* memory;
+    FreeBlock* freeList;
+    size_t blockSize;
+    size_t blockCount;
+    size_t freeBlocks;
+    size_t minFreeBlocks;
+    uint32_t exhaustedNum;
+    uint32_t oversizedNum;
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+
+public:
+    /**
+     * @brief Construct a new memory pool
+     *
+     * @param blockSize Size in bytes of each block, rounded up to 8 bytes
+     * @param blockCount Number of blocks inside the pool
+     */
+    LM_MemoryPool(size_t blockSize, size_t blockCount)
+        : freeList(nullptr), blockCount(blockCount), freeBlocks(0), minFreeBlocks(0), exhaustedNum(0), oversizedNum(0) {
+        if (blockSize < sizeof(FreeBlock))
+            blockSize = sizeof(FreeBlock);
+
+        this->blockSize = (blockSize + 7) & ~((size_t) 7);
+
+        memory = static_cast<uint8_t*>(pvPortMalloc(this->blockSize * blockCount));
+        if (memory == nullptr) {
+            this->blockCount = 0;
+            return;
+        }
+
+        for (size_t i = blockCount; i > 0; i--) {
+            FreeBlock* block = reinterpret_cast<FreeBlock*>(memory + (i - 1) * this->blockSize);
+            block->next = freeList;
+            freeList = block;
+        }
+
+        freeBlocks = minFreeBlocks = blockCount;
+    }
+
+    ~LM_MemoryPool() {
+        vPortFree(memory);
+    }
+
+    /**
+     * @brief Get a block from the pool
+     *
+     * @param size Number of bytes needed
+     * @return void* The block or nullptr if the size is greater than the block size or the pool is empty
+     */
+    void* Allocate(size_t size) {
+        void* block = nullptr;
+
+        portENTER_CRITICAL(&mux);
+
+        if (size > blockSize)
+            oversizedNum++;
+        else if (freeList == nullptr)
+            exhaustedNum++;
+        else {
+            block = freeList;
+            freeList = freeList->next;
+            freeBlocks--;
+            if (freeBlocks < minFreeBlocks)
+                minFreeBlocks = freeBlocks;
+        }
+
+        portEXIT_CRITICAL(&mux);
+
+        return block;
+    }
+
+    /**
+     * @brief Return a block to the pool
+     *
+     * @param p Block to be returned
+     * @return true If the block belongs to this pool
+     * @return false If the block does not belong to this pool, nothing has been done
+     */
+    bool Free(void* p) {
+        if (!Owns(p))
+            return false;
+
+        portENTER_CRITICAL(&mux);
+
+        FreeBlock* block = static_cast<FreeBlock*>(p);
+        block->next = freeList;
+        freeList = block;
+        freeBlocks++;
+
+        portEXIT_CRITICAL(&mux);
+
+        return true;
+    }
+
+    /**
+     * @brief Returns if the pointer is inside the memory of this pool
+     *
+     * @param p pointer
+     */
+    bool Owns(void* p) const {
+        uint8_t* ptr = static_cast<uint8_t*>(p);
+        return memory != nullptr && ptr >= memory && ptr < memory + blockSize * blockCount;
+    }
+
+    size_t getBlockSize() const { return blockSize; }
+
+    size_t getBlockCount() const { return blockCount; }
+
+    size_t getFreeBlocks() const { return freeBlocks; }
+
+    size_t getMinFreeBlocks() const { return minFreeBlocks; }
+
+    /**
+     * @brief Number of allocations that did not get a block because the pool was empty
+     */
+    uint32_t getExhaustedNum() const { return exhaustedNum; }
+
+    /**
+     * @brief Number of allocations that did not get a block because they were greater than the block size
+     */
+    uint32_t getOversizedNum() const { return oversizedNum; }
+};
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Bounded binary max-heap ordered by the priority field of the elements.
+ * Elements with the same priority are returned in insertion order (FIFO).
+ *
+ * @tparam T Type of the elements, it needs a priority member
+ */
+template <class T>
+class LM_PriorityQueue {
+private:
+    struct HeapEntry {
+        T* element;
+        uint32_t sequence;
+    };
+
+    HeapEntry* heap;
+    size_t capacity;
+    size_t length;
+    size_t peakLength;
+    uint32_t nextSequence;
+    uint32_t overflows;
+    SemaphoreHandle_t xSemaphore;
+
+    bool isBefore(const HeapEntry& a, const HeapEntry& b);
+    void siftUp(size_t index);
+    void siftDown(size_t index);
+public:
+    LM_PriorityQueue(size_t capacity);
+    ~LM_PriorityQueue();
+    bool Push(T*);
+    T* Pop();
+    T* First() const;
+    size_t getLength() { return length; }
+    size_t getCapacity() { return capacity; }
+    size_t getPeakLength() { return peakLength; }
+    uint32_t getOverflows() { return overflows; }
+    void Clear();
+    void setInUse();
+    void releaseInUse();
+};
+
+template <class T>
+LM_PriorityQueue<T>::LM_PriorityQueue(size_t capacity)
+    : capacity(capacity), length(0), peakLength(0), nextSequence(0), overflows(0) {
+    heap = new HeapEntry[capacity];
+
+    /* Attempt to create a semaphore. */
+    xSemaphore = xSemaphoreCreateMutex();
+
+    if (xSemaphore == NULL) {
+        SAFE_ESP_LOGE(LM_TAG, "Semaphore in Priority Queue not created");
+    }
+}
+
+template <class T>
+LM_PriorityQueue<T>::~LM_PriorityQueue() {
+    delete[] heap;
+    vSemaphoreDelete(xSemaphore);
+}
+
+template <class T>
+bool LM_PriorityQueue<T>::isBefore(const HeapEntry& a, const HeapEntry& b) {
+    if (a.element->priority != b.element->priority)
+        return a.element->priority > b.element->priority;
+
+    // Wrap-around safe comparison of the insertion order
+    return (int32_t) (a.sequence - b.sequence) < 0;
+}
+
+template <class T>
+void LM_PriorityQueue<T>::siftUp(size_t index) {
+    HeapEntry entry = heap[index];
+
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!isBefore(entry, heap[parent]))
+            break;
+
+        heap[index] = heap[parent];
+        index = parent;
+    }
+
+    heap[index] = entry;
+}
+
+template <class T>
+void LM_PriorityQueue<T>::siftDown(size_t index) {
+    HeapEntry entry = heap[index];
+
+    for (;;) {
+        size_t child = 2 * index + 1;
+        if (child >= length)
+            break;
+
+        if (child + 1 < length && isBefore(heap[child + 1], heap[child]))
+            child++;
+
+        if (!isBefore(heap[child], entry))
+            break;
+
+        heap[index] = heap[child];
+        index = child;
+    }
+
+    heap[index] = entry;
+}
+
+template <class T>
+bool LM_PriorityQueue<T>::Push(T* element) {
+    if (length >= capacity) {
+        overflows++;
+        return false;
+    }
+
+    heap[length].element = element;
+    heap[length].sequence = nextSequence++;
+    siftUp(length);
+    length++;
+
+    if (length > peakLength)
+        peakLength = length;
+
+    return true;
+}
+
+template <class T>
+T* LM_PriorityQueue<T>::Pop() {
+    if (length == 0)
+        return nullptr;
+
+    T* element = heap[0].element;
+    length--;
+
+    if (length > 0) {
+        heap[0] = heap[length];
+        siftDown(0);
+    }
+
+    return element;
+}
+
+template <class T>
+T* LM_PriorityQueue<T>::First() const {
+    return length ? heap[0].element : nullptr;
+}
+
+template <class T>
+void LM_PriorityQueue<T>::Clear() {
+    length = 0;
+}
+
+template <class T>
+void LM_PriorityQueue<T>::setInUse() {
+    while (xSemaphoreTake(xSemaphore, (TickType_t) 10) != pdTRUE) {
+        ESP_LOGW(LM_TAG, "Priority Queue in Use Alert");
+    }
+}
+
+template <class T>
+void LM_PriorityQueue<T>::releaseInUse() {
+    xSemaphoreGive(xSemaphore);
+}
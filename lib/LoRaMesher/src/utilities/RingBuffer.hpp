@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Fixed capacity, lock-free, single producer/single consumer ring of pointers.
+ * Push() must only be called from one task and Pop() from another one.
+ * The capacity is rounded up to the next power of two.
+ *
+ * @tparam T Type of the elements
+ */
+template <class T>
+class LM_RingBuffer {
+private:
+    T** buffer;
+    size_t capacity;
+    size_t mask;
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+    std::atomic<uint32_t> overflows;
+    size_t peakLength;
+public:
+    LM_RingBuffer(size_t capacity);
+    ~LM_RingBuffer();
+    bool Push(T*);
+    T* Pop();
+    size_t getLength();
+    size_t getCapacity() { return capacity; }
+    size_t getPeakLength() { return peakLength; }
+    uint32_t getOverflows() { return overflows.load(std::memory_order_relaxed); }
+    void Clear();
+};
+
+template <class T>
+LM_RingBuffer<T>::LM_RingBuffer(size_t minCapacity) : head(0), tail(0), overflows(0), peakLength(0) {
+    capacity = 1;
+    while (capacity < minCapacity)
+        capacity <<= 1;
+
+    mask = capacity - 1;
+    buffer = new T * [capacity];
+}
+
+template <class T>
+LM_RingBuffer<T>::~LM_RingBuffer() {
+    delete[] buffer;
+}
+
+template <class T>
+bool LM_RingBuffer<T>::Push(T* element) {
+    size_t currentTail = tail.load(std::memory_order_relaxed);
+    size_t currentHead = head.load(std::memory_order_acquire);
+
+    if (currentTail - currentHead >= capacity) {
+        overflows.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    buffer[currentTail & mask] = element;
+    tail.store(currentTail + 1, std::memory_order_release);
+
+    size_t length = currentTail + 1 - currentHead;
+    if (length > peakLength)
+        peakLength = length;
+
+    return true;
+}
+
+template <class T>
+T* LM_RingBuffer<T>::Pop() {
+    size_t currentHead = head.load(std::memory_order_relaxed);
+    size_t currentTail = tail.load(std::memory_order_acquire);
+
+    if (currentHead == currentTail)
+        return nullptr;
+
+    T* element = buffer[currentHead & mask];
+    head.store(currentHead + 1, std::memory_order_release);
+
+    return element;
+}
+
+template <class T>
+size_t LM_RingBuffer<T>::getLength() {
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+}
+
+template <class T>
+void LM_RingBuffer<T>::Clear() {
+    head.store(tail.load(std::memory_order_acquire), std::memory_order_release);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Helpers of the selective ACK bitmaps. Bit i of a bitmap is set if the packet lastAck + 1 + i
+ * of the sequence has been received. The receiver keeps one for each sequence and sends it inside
+ * the SACK packets. The bits are stored from the least significant bit of the first byte.
+ *
+ */
+class LM_SackBitmap {
+public:
+    /**
+     * @brief Set a bit, the bits outside the bitmap are ignored
+     *
+     * @param bitmap Bitmap
+     * @param size Size of the bitmap in bytes
+     * @param bit Bit to be set
+     */
+    static void Set(uint8_t* bitmap, size_t size, size_t bit) {
+        if (bit < size * 8)
+            bitmap[bit / 8] |= 1 << (bit % 8);
+    }
+
+    /**
+     * @brief Returns if a bit is set, the bits outside the bitmap are not
+     *
+     * @param bitmap Bitmap
+     * @param size Size of the bitmap in bytes
+     * @param bit Bit to be checked
+     */
+    static bool Get(const uint8_t* bitmap, size_t size, size_t bit) {
+        return bit < size * 8 && (bitmap[bit / 8] & (1 << (bit % 8)));
+    }
+
+    /**
+     * @brief Move all the bits one position down, the first one is dropped. Used when lastAck is incremented
+     *
+     * @param bitmap Bitmap
+     * @param size Size of the bitmap in bytes
+     */
+    static void Shift(uint8_t* bitmap, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            uint8_t carry = (i + 1 < size) ? (bitmap[i + 1] & 1) : 0;
+            bitmap[i] = (bitmap[i] >> 1) | (carry << 7);
+        }
+    }
+
+    /**
+     * @brief Returns if any bit is set
+     *
+     * @param bitmap Bitmap
+     * @param size Size of the bitmap in bytes
+     */
+    static bool Any(const uint8_t* bitmap, size_t size) {
+        for (size_t i = 0; i < size; i++)
+            if (bitmap[i] != 0)
+                return true;
+
+        return false;
+    }
+
+    /**
+     * @brief Get the last bit set
+     *
+     * @param bitmap Bitmap
+     * @param size Size of the bitmap in bytes
+     * @return int32_t Position of the bit or -1 if none is set
+     */
+    static int32_t Last(const uint8_t* bitmap, size_t size) {
+        for (int32_t bit = size * 8 - 1; bit >= 0; bit--)
+            if (bitmap[bit / 8] & (1 << (bit % 8)))
+                return bit;
+
+        return -1;
+    }
+};
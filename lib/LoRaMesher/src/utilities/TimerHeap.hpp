@@ -0,0 +1,211 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Indexed binary min-heap of deadlines in ms. Each element keeps its position inside the heap
+ * in a timerIndex member, so a deadline can be changed or cancelled in O(log n) without searching it.
+ * Deadlines are compared wrap-around safe, they need to be less than 24 days apart.
+ * The heap grows when it is full.
+ *
+ * @tparam T Type of the elements, it needs a size_t timerIndex member initialized to SIZE_MAX
+ */
+template <class T>
+class LM_TimerHeap {
+private:
+    struct HeapEntry {
+        T* element;
+        unsigned long deadline;
+    };
+
+    HeapEntry* heap;
+    size_t capacity;
+    size_t length;
+    SemaphoreHandle_t xSemaphore;
+
+    static bool isBefore(unsigned long a, unsigned long b) { return (long) (a - b) < 0; }
+    void place(size_t index, const HeapEntry& entry);
+    void siftUp(size_t index);
+    void siftDown(size_t index);
+    bool grow();
+public:
+    LM_TimerHeap(size_t capacity);
+    ~LM_TimerHeap();
+    bool Schedule(T* element, unsigned long deadline);
+    bool Cancel(T* element);
+    T* PopExpired(unsigned long now);
+    T* First() const;
+    unsigned long getFirstDeadline() const;
+    size_t getLength() { return length; }
+    void Clear();
+    void setInUse();
+    void releaseInUse();
+};
+
+template <class T>
+LM_TimerHeap<T>::LM_TimerHeap(size_t capacity) : capacity(capacity ? capacity : 1), length(0) {
+    heap = new HeapEntry[this->capacity];
+
+    /* Attempt to create a semaphore. */
+    xSemaphore = xSemaphoreCreateMutex();
+
+    if (xSemaphore == NULL) {
+        SAFE_ESP_LOGE(LM_TAG, "Semaphore in Timer Heap not created");
+    }
+}
+
+template <class T>
+LM_TimerHeap<T>::~LM_TimerHeap() {
+    delete[] heap;
+    vSemaphoreDelete(xSemaphore);
+}
+
+template <class T>
+void LM_TimerHeap<T>::place(size_t index, const HeapEntry& entry) {
+    heap[index] = entry;
+    entry.element->timerIndex = index;
+}
+
+template <class T>
+void LM_TimerHeap<T>::siftUp(size_t index) {
+    HeapEntry entry = heap[index];
+
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!isBefore(entry.deadline, heap[parent].deadline))
+            break;
+
+        place(index, heap[parent]);
+        index = parent;
+    }
+
+    place(index, entry);
+}
+
+template <class T>
+void LM_TimerHeap<T>::siftDown(size_t index) {
+    HeapEntry entry = heap[index];
+
+    for (;;) {
+        size_t child = 2 * index + 1;
+        if (child >= length)
+            break;
+
+        if (child + 1 < length && isBefore(heap[child + 1].deadline, heap[child].deadline))
+            child++;
+
+        if (!isBefore(heap[child].deadline, entry.deadline))
+            break;
+
+        place(index, heap[child]);
+        index = child;
+    }
+
+    place(index, entry);
+}
+
+template <class T>
+bool LM_TimerHeap<T>::grow() {
+    HeapEntry* newHeap = new HeapEntry[capacity * 2];
+    if (newHeap == nullptr)
+        return false;
+
+    memcpy(newHeap, heap, length * sizeof(HeapEntry));
+    delete[] heap;
+
+    heap = newHeap;
+    capacity *= 2;
+    return true;
+}
+
+template <class T>
+bool LM_TimerHeap<T>::Schedule(T* element, unsigned long deadline) {
+    size_t index = element->timerIndex;
+
+    // Already scheduled, move it to the new position
+    if (index < length && heap[index].element == element) {
+        unsigned long previous = heap[index].deadline;
+        heap[index].deadline = deadline;
+
+        if (isBefore(deadline, previous))
+            siftUp(index);
+        else
+            siftDown(index);
+
+        return true;
+    }
+
+    if (length >= capacity && !grow()) {
+        SAFE_ESP_LOGE(LM_TAG, "Timer Heap full");
+        return false;
+    }
+
+    heap[length].element = element;
+    heap[length].deadline = deadline;
+    length++;
+    siftUp(length - 1);
+
+    return true;
+}
+
+template <class T>
+bool LM_TimerHeap<T>::Cancel(T* element) {
+    size_t index = element->timerIndex;
+    if (index >= length || heap[index].element != element)
+        return false;
+
+    element->timerIndex = SIZE_MAX;
+    length--;
+
+    if (index < length) {
+        unsigned long removed = heap[index].deadline;
+        place(index, heap[length]);
+
+        if (isBefore(heap[index].deadline, removed))
+            siftUp(index);
+        else
+            siftDown(index);
+    }
+
+    return true;
+}
+
+template <class T>
+T* LM_TimerHeap<T>::PopExpired(unsigned long now) {
+    if (length == 0 || isBefore(now, heap[0].deadline))
+        return nullptr;
+
+    T* element = heap[0].element;
+    Cancel(element);
+    return element;
+}
+
+template <class T>
+T* LM_TimerHeap<T>::First() const {
+    return length ? heap[0].element : nullptr;
+}
+
+template <class T>
+unsigned long LM_TimerHeap<T>::getFirstDeadline() const {
+    return length ? heap[0].deadline : 0;
+}
+
+template <class T>
+void LM_TimerHeap<T>::Clear() {
+    for (size_t i = 0; i < length; i++)
+        heap[i].element->timerIndex = SIZE_MAX;
+
+    length = 0;
+}
+
+template <class T>
+void LM_TimerHeap<T>::setInUse() {
+    while (xSemaphoreTake(xSemaphore, (TickType_t) 10) != pdTRUE) {
+        ESP_LOGW(LM_TAG, "Timer Heap in Use Alert");
+    }
+}
+
+template <class T>
+void LM_TimerHeap<T>::releaseInUse() {
+    xSemaphoreGive(xSemaphore);
+}
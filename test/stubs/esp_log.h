@@ -0,0 +1,7 @@
+#pragma once
+
+#define ESP_LOGE(tag, ...) ((void) (tag))
+#define ESP_LOGW(tag, ...) ((void) (tag))
+#define ESP_LOGI(tag, ...) ((void) (tag))
+#define ESP_LOGD(tag, ...) ((void) (tag))
+#define ESP_LOGV(tag, ...) ((void) (tag))
@@ -0,0 +1,30 @@
+#pragma once
+
+// Host build of the FreeRTOS types and macros used by the LoRaMesher utilities
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+typedef void* TaskHandle_t;
+typedef void* QueueHandle_t;
+typedef void* SemaphoreHandle_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define portMAX_DELAY 0xffffffffUL
+
+// The tests run in a single thread, the critical sections do nothing
+typedef struct {
+    uint32_t owner;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) ((void) (mux))
+#define portEXIT_CRITICAL(mux) ((void) (mux))
+
+void* pvPortMalloc(size_t size);
+void vPortFree(void* p);
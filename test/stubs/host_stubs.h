@@ -0,0 +1,59 @@
+#pragma once
+
+// Host definitions of the ESP32, FreeRTOS and logging functions used by the LoRaMesher utilities.
+// Include it once in each test program, before the utilities.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "LogManager.h"
+#include "services/MemoryPoolService.h"
+
+const char* LM_TAG = "LoRaMesher";
+const char* LM_VERSION = "test";
+
+// Time returned by millis(), the tests move it forward
+unsigned long hostMillis = 0;
+
+unsigned long millis() { return hostMillis; }
+
+long random(long howsmall, long howbig) { return howsmall + rand() % (howbig - howsmall); }
+
+size_t getFreeHeap() { return 0; }
+
+void* pvPortMalloc(size_t size) { return malloc(size); }
+
+void vPortFree(void* p) { free(p); }
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return malloc(1); }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t) { return pdTRUE; }
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) { free(semaphore); }
+
+// The nodes of LM_LinkedList come from the heap
+void* MemoryPoolService::allocateListNode(size_t size) { return malloc(size); }
+
+void MemoryPoolService::freeListNode(void* p) { free(p); }
+
+void LogManager::logError(const char* tag, const char*, int, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "E %s: ", tag);
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+}
+
+void LogManager::logWarn(const char*, const char*, int, const char*, ...) {}
+
+void LogManager::logInfo(const char*, const char*, int, const char*, ...) {}
+
+void LogManager::logDebug(const char*, const char*, int, const char*, ...) {}
+
+void LogManager::logVerbose(const char*, const char*, int, const char*, ...) {}
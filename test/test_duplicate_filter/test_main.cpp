@@ -0,0 +1,87 @@
+#include <unity.h>
+
+#include "host_stubs.h"
+
+#include "utilities/DuplicateFilter.hpp"
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_new_then_duplicate() {
+    LM_DuplicateFilter filter(64, 0.01, 2000);
+
+    TEST_ASSERT_FALSE(filter.CheckAndInsert(0x12345678, 100));
+    TEST_ASSERT_TRUE(filter.CheckAndInsert(0x12345678, 100));
+    TEST_ASSERT_TRUE(filter.CheckAndInsert(0x12345678, 1500));
+}
+
+void test_no_false_negatives() {
+    LM_DuplicateFilter filter(64, 0.01, 2000);
+
+    for (uint32_t i = 0; i < 64; i++)
+        filter.CheckAndInsert(i * 7919 + 13, 100);
+
+    for (uint32_t i = 0; i < 64; i++)
+        TEST_ASSERT_TRUE(filter.CheckAndInsert(i * 7919 + 13, 100));
+}
+
+void test_false_positive_rate() {
+    LM_DuplicateFilter filter(256, 0.01, 60000);
+    int falsePositives = 0;
+
+    for (uint32_t i = 0; i < 256; i++)
+        filter.CheckAndInsert(i * 2654435761u, 100);
+
+    for (uint32_t i = 0; i < 1000; i++)
+        if (filter.CheckAndInsert((i + 100000) * 40503u ^ 0x5bd1e995, 100))
+            falsePositives++;
+
+    // 1% when full, some margin for the fingerprints inserted while checking
+    TEST_ASSERT_LESS_THAN(50, falsePositives);
+}
+
+void test_forgotten_after_two_generations() {
+    LM_DuplicateFilter filter(64, 0.01, 2000);
+
+    filter.CheckAndInsert(42, 0);
+
+    // Still remembered during the next generation
+    TEST_ASSERT_TRUE(filter.CheckAndInsert(42, 2500));
+
+    // The generation where it was inserted is cleared
+    filter.CheckAndInsert(1, 5000);
+    TEST_ASSERT_FALSE(filter.CheckAndInsert(42, 5000));
+}
+
+void test_rotates_when_full() {
+    LM_DuplicateFilter filter(8, 0.01, 60000);
+
+    filter.CheckAndInsert(42, 0);
+
+    // Two full generations without time passing
+    for (uint32_t i = 1; i <= 16; i++)
+        filter.CheckAndInsert(i * 1000003u, 0);
+
+    TEST_ASSERT_FALSE(filter.CheckAndInsert(42, 0));
+}
+
+void test_clear() {
+    LM_DuplicateFilter filter(64, 0.01, 2000);
+
+    filter.CheckAndInsert(42, 0);
+    filter.Clear();
+
+    TEST_ASSERT_FALSE(filter.CheckAndInsert(42, 0));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_new_then_duplicate);
+    RUN_TEST(test_no_false_negatives);
+    RUN_TEST(test_false_positive_rate);
+    RUN_TEST(test_forgotten_after_two_generations);
+    RUN_TEST(test_rotates_when_full);
+    RUN_TEST(test_clear);
+    return UNITY_END();
+}
@@ -0,0 +1,148 @@
+#include <unity.h>
+
+#include <chrono>
+
+#include "host_stubs.h"
+
+#include "entities/routingTable/RouteNode.h"
+#include "utilities/HashIndex.hpp"
+#include "utilities/LinkedQueue.hpp"
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_insert_and_find() {
+    LM_HashIndex<int> index(16);
+    int values[16];
+
+    for (int i = 0; i < 16; i++)
+        TEST_ASSERT_TRUE(index.Insert(0x1000 + i, &values[i]));
+
+    TEST_ASSERT_EQUAL_UINT(16, index.getLength());
+
+    for (int i = 0; i < 16; i++)
+        TEST_ASSERT_EQUAL_PTR(&values[i], index.Find(0x1000 + i));
+
+    TEST_ASSERT_NULL(index.Find(0x2000));
+}
+
+void test_insert_replaces_the_element() {
+    LM_HashIndex<int> index(4);
+    int first = 0, second = 0;
+
+    index.Insert(42, &first);
+    index.Insert(42, &second);
+
+    TEST_ASSERT_EQUAL_UINT(1, index.getLength());
+    TEST_ASSERT_EQUAL_PTR(&second, index.Find(42));
+}
+
+void test_remove_keeps_the_cluster() {
+    LM_HashIndex<int> index(64);
+    int values[64];
+
+    // Addresses sharing the high bits collide, removing one must not hide the ones after it
+    for (int i = 0; i < 64; i++)
+        index.Insert(i << 8, &values[i]);
+
+    for (int i = 0; i < 64; i += 2)
+        TEST_ASSERT_TRUE(index.Remove(i << 8));
+
+    TEST_ASSERT_FALSE(index.Remove(0));
+    TEST_ASSERT_EQUAL_UINT(32, index.getLength());
+
+    for (int i = 0; i < 64; i++) {
+        if (i % 2 == 0)
+            TEST_ASSERT_NULL(index.Find(i << 8));
+        else
+            TEST_ASSERT_EQUAL_PTR(&values[i], index.Find(i << 8));
+    }
+}
+
+void test_clear() {
+    LM_HashIndex<int> index(4);
+    int value = 0;
+
+    index.Insert(1, &value);
+    index.Clear();
+
+    TEST_ASSERT_EQUAL_UINT(0, index.getLength());
+    TEST_ASSERT_NULL(index.Find(1));
+}
+
+// Lookup of the routing table before the index, a scan of the list
+static RouteNode* findInList(LM_LinkedList<RouteNode>& list, uint16_t address) {
+    if (list.moveToStart()) {
+        do {
+            RouteNode* node = list.getCurrent();
+            if (node->networkNode.address == address)
+                return node;
+        } while (list.next());
+    }
+
+    return nullptr;
+}
+
+// Time in ns of each lookup of a hello entry in a routing table of the size, with the list scan and with the index
+static void benchmarkLookups(size_t routes, double& listNs, double& indexNs) {
+    const uint32_t lookups = 200000;
+    LM_LinkedList<RouteNode> list;
+    LM_HashIndex<RouteNode> index(routes);
+    RouteNode** nodes = new RouteNode*[routes];
+
+    for (size_t i = 0; i < routes; i++) {
+        nodes[i] = new RouteNode(0x1000 + i * 7, 1, 0, 0x1000);
+        list.Append(nodes[i]);
+        index.Insert(nodes[i]->networkNode.address, nodes[i]);
+    }
+
+    // The hellos contain the routes of the neighbors, most of them are already in the table, one of each eight is not
+    uintptr_t found = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < lookups; i++)
+        found += (uintptr_t) findInList(list, nodes[(i * 31) % routes]->networkNode.address + (i % 8 == 0));
+    auto middle = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < lookups; i++)
+        found -= (uintptr_t) index.Find(nodes[(i * 31) % routes]->networkNode.address + (i % 8 == 0));
+    auto end = std::chrono::steady_clock::now();
+
+    // Both need to find the same routes
+    TEST_ASSERT_EQUAL_UINT(0, found);
+
+    listNs = std::chrono::duration<double, std::nano>(middle - start).count() / lookups;
+    indexNs = std::chrono::duration<double, std::nano>(end - middle).count() / lookups;
+
+    list.Clear();
+    for (size_t i = 0; i < routes; i++)
+        delete nodes[i];
+    delete[] nodes;
+}
+
+void test_lookup_benchmark() {
+    const size_t sizes[] = {16, 64, 256};
+    char message[96];
+
+    for (size_t routes : sizes) {
+        double listNs, indexNs;
+        benchmarkLookups(routes, listNs, indexNs);
+
+        snprintf(message, sizeof(message), "%3u routes: list %8.1f ns, index %6.1f ns per lookup", (unsigned) routes, listNs, indexNs);
+        TEST_MESSAGE(message);
+
+        // The scan grows with the routes, the index does not
+        if (routes >= 64)
+            TEST_ASSERT_TRUE(indexNs < listNs);
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_insert_and_find);
+    RUN_TEST(test_insert_replaces_the_element);
+    RUN_TEST(test_remove_keeps_the_cluster);
+    RUN_TEST(test_clear);
+    RUN_TEST(test_lookup_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,119 @@
+#include <unity.h>
+
+#include "host_stubs.h"
+
+#include "utilities/MemoryPool.hpp"
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_block_size_rounded_to_8_bytes() {
+    LM_MemoryPool pool(13, 4);
+    TEST_ASSERT_EQUAL_UINT(16, pool.getBlockSize());
+    TEST_ASSERT_EQUAL_UINT(4, pool.getBlockCount());
+    TEST_ASSERT_EQUAL_UINT(4, pool.getFreeBlocks());
+}
+
+void test_allocate_until_exhausted() {
+    LM_MemoryPool pool(32, 3);
+    void* blocks[3];
+
+    for (int i = 0; i < 3; i++) {
+        blocks[i] = pool.Allocate(32);
+        TEST_ASSERT_NOT_NULL(blocks[i]);
+        TEST_ASSERT_TRUE(pool.Owns(blocks[i]));
+    }
+
+    TEST_ASSERT_TRUE(blocks[0] != blocks[1] && blocks[1] != blocks[2] && blocks[0] != blocks[2]);
+
+    TEST_ASSERT_NULL(pool.Allocate(32));
+    TEST_ASSERT_EQUAL_UINT32(1, pool.getExhaustedNum());
+    TEST_ASSERT_EQUAL_UINT(0, pool.getMinFreeBlocks());
+}
+
+void test_oversized_allocation() {
+    LM_MemoryPool pool(16, 2);
+
+    TEST_ASSERT_NULL(pool.Allocate(17));
+    TEST_ASSERT_EQUAL_UINT32(1, pool.getOversizedNum());
+    TEST_ASSERT_EQUAL_UINT(2, pool.getFreeBlocks());
+}
+
+void test_free_reuses_the_block() {
+    LM_MemoryPool pool(16, 2);
+
+    void* block = pool.Allocate(8);
+    TEST_ASSERT_TRUE(pool.Free(block));
+    TEST_ASSERT_EQUAL_UINT(2, pool.getFreeBlocks());
+    TEST_ASSERT_EQUAL_UINT(1, pool.getMinFreeBlocks());
+
+    // The last freed block is the first one given again
+    TEST_ASSERT_EQUAL_PTR(block, pool.Allocate(16));
+}
+
+void test_free_foreign_pointer() {
+    LM_MemoryPool pool(16, 2);
+    int value = 0;
+
+    TEST_ASSERT_FALSE(pool.Owns(&value));
+    TEST_ASSERT_FALSE(pool.Free(&value));
+    TEST_ASSERT_EQUAL_UINT(2, pool.getFreeBlocks());
+}
+
+void test_no_fragmentation_after_a_million_cycles() {
+    const size_t blockCount = 64;
+    LM_MemoryPool pool(200, blockCount);
+    void* live[blockCount];
+    size_t liveNum = 0;
+    uint32_t seed = 12345;
+
+    // Random allocations of different sizes and frees in random order, up to the whole pool in use
+    for (uint32_t cycle = 0; cycle < 1000000; cycle++) {
+        seed = seed * 1103515245 + 12345;
+        bool allocate = liveNum == 0 || (liveNum < blockCount && (seed >> 16) % 2 == 0);
+
+        if (allocate) {
+            live[liveNum] = pool.Allocate(1 + (seed >> 8) % 200);
+            TEST_ASSERT_NOT_NULL(live[liveNum]);
+            liveNum++;
+        }
+        else {
+            size_t i = (seed >> 16) % liveNum;
+            TEST_ASSERT_TRUE(pool.Free(live[i]));
+            live[i] = live[--liveNum];
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(0, pool.getExhaustedNum());
+    TEST_ASSERT_EQUAL_UINT(blockCount - liveNum, pool.getFreeBlocks());
+
+    while (liveNum > 0)
+        pool.Free(live[--liveNum]);
+
+    // Every block can still be allocated with the largest size, once
+    for (size_t i = 0; i < blockCount; i++) {
+        live[i] = pool.Allocate(200);
+        TEST_ASSERT_NOT_NULL(live[i]);
+
+        for (size_t j = 0; j < i; j++)
+            TEST_ASSERT_TRUE(live[i] != live[j]);
+    }
+
+    TEST_ASSERT_NULL(pool.Allocate(1));
+
+    char message[64];
+    snprintf(message, sizeof(message), "minimum free blocks %u of %u", (unsigned) pool.getMinFreeBlocks(), (unsigned) blockCount);
+    TEST_MESSAGE(message);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_block_size_rounded_to_8_bytes);
+    RUN_TEST(test_allocate_until_exhausted);
+    RUN_TEST(test_oversized_allocation);
+    RUN_TEST(test_free_reuses_the_block);
+    RUN_TEST(test_free_foreign_pointer);
+    RUN_TEST(test_no_fragmentation_after_a_million_cycles);
+    return UNITY_END();
+}
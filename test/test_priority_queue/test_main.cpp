@@ -0,0 +1,84 @@
+#include <unity.h>
+
+#include "host_stubs.h"
+
+#include "utilities/PriorityQueue.hpp"
+
+struct Element {
+    uint8_t priority;
+    int id;
+};
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_highest_priority_first() {
+    LM_PriorityQueue<Element> queue(8);
+    Element low = {1, 0}, high = {9, 1}, medium = {5, 2};
+
+    queue.Push(&low);
+    queue.Push(&high);
+    queue.Push(&medium);
+
+    TEST_ASSERT_EQUAL_PTR(&high, queue.First());
+    TEST_ASSERT_EQUAL_PTR(&high, queue.Pop());
+    TEST_ASSERT_EQUAL_PTR(&medium, queue.Pop());
+    TEST_ASSERT_EQUAL_PTR(&low, queue.Pop());
+    TEST_ASSERT_NULL(queue.Pop());
+}
+
+void test_same_priority_in_insertion_order() {
+    LM_PriorityQueue<Element> queue(16);
+    Element elements[12];
+
+    // Mixed priorities, the ones with the same priority need to keep their order
+    for (int i = 0; i < 12; i++) {
+        elements[i] = {(uint8_t) (i % 3), i};
+        queue.Push(&elements[i]);
+    }
+
+    int previousId[3] = {-1, -1, -1};
+    int previousPriority = 255;
+
+    while (Element* element = queue.Pop()) {
+        TEST_ASSERT_LESS_OR_EQUAL(previousPriority, element->priority);
+        TEST_ASSERT_GREATER_THAN(previousId[element->priority], element->id);
+
+        previousPriority = element->priority;
+        previousId[element->priority] = element->id;
+    }
+}
+
+void test_bounded_capacity() {
+    LM_PriorityQueue<Element> queue(2);
+    Element element = {0, 0};
+
+    TEST_ASSERT_TRUE(queue.Push(&element));
+    TEST_ASSERT_TRUE(queue.Push(&element));
+    TEST_ASSERT_FALSE(queue.Push(&element));
+
+    TEST_ASSERT_EQUAL_UINT(2, queue.getLength());
+    TEST_ASSERT_EQUAL_UINT(2, queue.getPeakLength());
+    TEST_ASSERT_EQUAL_UINT32(1, queue.getOverflows());
+}
+
+void test_clear() {
+    LM_PriorityQueue<Element> queue(4);
+    Element element = {3, 0};
+
+    queue.Push(&element);
+    queue.Clear();
+
+    TEST_ASSERT_EQUAL_UINT(0, queue.getLength());
+    TEST_ASSERT_NULL(queue.First());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_highest_priority_first);
+    RUN_TEST(test_same_priority_in_insertion_order);
+    RUN_TEST(test_bounded_capacity);
+    RUN_TEST(test_clear);
+    return UNITY_END();
+}
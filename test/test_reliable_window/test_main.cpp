@@ -0,0 +1,216 @@
+#include <unity.h>
+
+#include <queue>
+#include <vector>
+
+#include "host_stubs.h"
+
+#include "BuildOptions.h"
+
+// Simulation of a reliable payload sent with a sliding window through a chain of nodes. It follows the rules
+// of sendReliablePacket and processLargePayloadPacket: cumulative ACKs, the receiver keeps the packets received
+// out of order inside the window and asks once for the first missing one with a LOST_P, the sender retransmits
+// the first packet not acknowledged when its timeout expires. Each node sends one packet at a time.
+
+static const uint16_t PACKETS = 10;             // 2 KB payload in packets of 200 bytes
+static const uint16_t PACKET_BYTES = 200;
+static const uint8_t HOPS = 3;
+static const unsigned long DATA_AIRTIME = 330;  // ms of a 200 bytes packet at SF7 125 kHz
+static const unsigned long CONTROL_AIRTIME = 40;
+static const unsigned long TIMEOUT = MIN_TIMEOUT * 1000UL + HOPS * 5000UL;
+
+enum class Kind { DATA, ACK, LOST, TIMEOUT };
+
+struct Event {
+    unsigned long time;
+    Kind kind;
+    uint8_t node;
+    uint16_t number;
+    uint32_t timer;
+
+    bool operator>(const Event& other) const { return time > other.time; }
+};
+
+class Simulation {
+public:
+    Simulation(uint8_t windowSize, uint32_t lossPerMille, uint32_t seed):
+        windowSize(windowSize), lossPerMille(lossPerMille), seed(seed), busy(HOPS + 1, 0), buffered(PACKETS, false) {}
+
+    // Returns the ms needed to acknowledge all the packets
+    unsigned long run() {
+        sendWindow(0);
+        startTimer(0);
+
+        while (!events.empty()) {
+            Event event = events.top();
+            events.pop();
+
+            if (event.kind == Kind::TIMEOUT) {
+                if (event.timer != timer)
+                    continue;
+
+                send(0, Kind::DATA, base, event.time);
+                startTimer(event.time);
+            }
+            else if (event.kind == Kind::DATA && event.node != HOPS)
+                send(event.node, Kind::DATA, event.number, event.time);
+            else if (event.kind != Kind::DATA && event.node != 0)
+                send(event.node, event.kind, event.number, event.time);
+            else if (event.kind == Kind::DATA)
+                receiverData(event.number, event.time);
+            else if (senderControl(event.kind, event.number, event.time))
+                return event.time;
+        }
+
+        return 0;
+    }
+
+private:
+    uint8_t windowSize;
+    uint32_t lossPerMille;
+    uint32_t seed;
+    std::vector<unsigned long> busy;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+
+    uint16_t base = 0;
+    uint16_t next = 0;
+    uint32_t timer = 0;
+
+    uint16_t expected = 0;
+    std::vector<bool> buffered;
+    int32_t lostRequested = -1;
+
+    uint32_t random() {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) % 1000;
+    }
+
+    // Data goes from node 0 to node HOPS, the ACKs and LOST_P back
+    void send(uint8_t node, Kind kind, uint16_t number, unsigned long time) {
+        unsigned long start = max(time, busy[node]);
+        busy[node] = start + (kind == Kind::DATA ? DATA_AIRTIME : CONTROL_AIRTIME);
+
+        if (random() < lossPerMille)
+            return;
+
+        uint8_t to = kind == Kind::DATA ? node + 1 : node - 1;
+        events.push({busy[node], kind, to, number, 0});
+    }
+
+    void startTimer(unsigned long time) {
+        events.push({time + TIMEOUT, Kind::TIMEOUT, 0, 0, ++timer});
+    }
+
+    void sendWindow(unsigned long time) {
+        for (; next < base + windowSize && next < PACKETS; next++)
+            send(0, Kind::DATA, next, time);
+    }
+
+    // Returns true when all the packets are acknowledged
+    bool senderControl(Kind kind, uint16_t number, unsigned long time) {
+        if (kind == Kind::ACK) {
+            // A repeated ACK is ignored
+            if (number + 1 <= base)
+                return false;
+
+            base = number + 1;
+            if (base == PACKETS)
+                return true;
+        }
+        else {
+            // The LOST_P acknowledges every packet before it
+            if (number > base)
+                base = number;
+
+            send(0, Kind::DATA, number, time);
+        }
+
+        if (next < base)
+            next = base;
+
+        sendWindow(time);
+        startTimer(time);
+        return false;
+    }
+
+    void receiverData(uint16_t number, unsigned long time) {
+        if (number == expected) {
+            expected++;
+            while (expected < PACKETS && buffered[expected])
+                expected++;
+        }
+        else if (number > expected) {
+            if (number < expected + windowSize)
+                buffered[number] = true;
+
+            // Ask once for each gap
+            if (lostRequested != expected) {
+                lostRequested = expected;
+                send(HOPS, Kind::LOST, expected, time);
+            }
+            return;
+        }
+
+        send(HOPS, Kind::ACK, expected - 1, time);
+    }
+};
+
+// Goodput in bits per second of the mean time of the runs, 0 if a run did not finish
+static double goodput(uint8_t windowSize, uint32_t lossPerMille) {
+    const uint32_t runs = 200;
+    unsigned long total = 0;
+
+    for (uint32_t i = 0; i < runs; i++) {
+        Simulation simulation(windowSize, lossPerMille, i + 1);
+        unsigned long time = simulation.run();
+        if (time == 0)
+            return 0;
+
+        total += time;
+    }
+
+    return PACKETS * PACKET_BYTES * 8.0 / (total / (double) runs / 1000.0);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_stop_and_wait_time_without_losses() {
+    Simulation simulation(1, 0, 1);
+
+    // Each packet waits for the ACK of the previous one
+    unsigned long roundTrip = HOPS * (DATA_AIRTIME + CONTROL_AIRTIME);
+    TEST_ASSERT_EQUAL_UINT32(PACKETS * roundTrip, simulation.run());
+}
+
+void test_goodput_vs_window_size() {
+    const uint8_t windows[] = {1, 2, 4, 8};
+    const uint32_t losses[] = {0, 50, 100};
+    char message[96];
+
+    for (uint32_t loss : losses) {
+        double stopAndWait = 0;
+
+        for (uint8_t window : windows) {
+            double bps = goodput(window, loss);
+            TEST_ASSERT_TRUE(bps > 0);
+
+            if (window == 1)
+                stopAndWait = bps;
+
+            snprintf(message, sizeof(message), "loss %2u%% per hop, window %u: %6.0f bps", (unsigned) (loss / 10), window, bps);
+            TEST_MESSAGE(message);
+
+            if (window == LM_RELIABLE_WINDOW_SIZE)
+                TEST_ASSERT_TRUE(bps > stopAndWait * 1.5);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_stop_and_wait_time_without_losses);
+    RUN_TEST(test_goodput_vs_window_size);
+    return UNITY_END();
+}
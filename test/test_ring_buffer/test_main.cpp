@@ -0,0 +1,132 @@
+#include <unity.h>
+
+#include <chrono>
+
+#include "host_stubs.h"
+
+#include "utilities/LinkedQueue.hpp"
+#include "utilities/RingBuffer.hpp"
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_capacity_rounded_to_power_of_two() {
+    LM_RingBuffer<int> ring(5);
+    TEST_ASSERT_EQUAL_UINT(8, ring.getCapacity());
+
+    LM_RingBuffer<int> exact(16);
+    TEST_ASSERT_EQUAL_UINT(16, exact.getCapacity());
+}
+
+void test_fifo_order() {
+    LM_RingBuffer<int> ring(4);
+    int values[3] = {1, 2, 3};
+
+    for (int i = 0; i < 3; i++)
+        TEST_ASSERT_TRUE(ring.Push(&values[i]));
+
+    TEST_ASSERT_EQUAL_UINT(3, ring.getLength());
+
+    for (int i = 0; i < 3; i++)
+        TEST_ASSERT_EQUAL_PTR(&values[i], ring.Pop());
+
+    TEST_ASSERT_NULL(ring.Pop());
+    TEST_ASSERT_EQUAL_UINT(0, ring.getLength());
+}
+
+void test_overflow_is_counted() {
+    LM_RingBuffer<int> ring(2);
+    int value = 0;
+
+    TEST_ASSERT_TRUE(ring.Push(&value));
+    TEST_ASSERT_TRUE(ring.Push(&value));
+    TEST_ASSERT_FALSE(ring.Push(&value));
+    TEST_ASSERT_EQUAL_UINT32(1, ring.getOverflows());
+    TEST_ASSERT_EQUAL_UINT(2, ring.getPeakLength());
+}
+
+void test_wraps_around() {
+    LM_RingBuffer<int> ring(4);
+    int values[10];
+
+    // More elements than the capacity go through it, the positions are reused
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT_TRUE(ring.Push(&values[i]));
+        TEST_ASSERT_EQUAL_PTR(&values[i], ring.Pop());
+    }
+
+    TEST_ASSERT_EQUAL_UINT(1, ring.getPeakLength());
+}
+
+void test_clear() {
+    LM_RingBuffer<int> ring(4);
+    int value = 0;
+
+    ring.Push(&value);
+    ring.Push(&value);
+    ring.Clear();
+
+    TEST_ASSERT_EQUAL_UINT(0, ring.getLength());
+    TEST_ASSERT_NULL(ring.Pop());
+}
+
+// The received packets come in bursts, processPackets takes all of them at each notification
+static const uint32_t BENCHMARK_PACKETS = 1000000;
+static const uint32_t BENCHMARK_BURST = 8;
+
+void test_ring_faster_than_list() {
+    LM_RingBuffer<int> ring(16);
+    LM_LinkedList<int> list;
+    int values[BENCHMARK_BURST];
+    uintptr_t popped = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < BENCHMARK_PACKETS; i += BENCHMARK_BURST) {
+        for (uint32_t j = 0; j < BENCHMARK_BURST; j++)
+            ring.Push(&values[j]);
+
+        int* value;
+        while ((value = ring.Pop()) != nullptr)
+            popped += (uintptr_t) value;
+    }
+    auto middle = std::chrono::steady_clock::now();
+    // Hand-off of the received packets before the ring, the list needs a node and the mutex for each one
+    for (uint32_t i = 0; i < BENCHMARK_PACKETS; i += BENCHMARK_BURST) {
+        for (uint32_t j = 0; j < BENCHMARK_BURST; j++) {
+            list.setInUse();
+            list.Append(&values[j]);
+            list.releaseInUse();
+        }
+
+        while (list.getLength() > 0) {
+            list.setInUse();
+            popped -= (uintptr_t) list.Pop();
+            list.releaseInUse();
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    TEST_ASSERT_EQUAL_UINT(0, popped);
+
+    double ringNs = std::chrono::duration<double, std::nano>(middle - start).count() / BENCHMARK_PACKETS;
+    double listNs = std::chrono::duration<double, std::nano>(end - middle).count() / BENCHMARK_PACKETS;
+
+    char message[80];
+    snprintf(message, sizeof(message), "ring %5.1f ns, list %5.1f ns per packet", ringNs, listNs);
+    TEST_MESSAGE(message);
+
+    // The host mutex is a stub and its heap is faster than the ESP32 one, the gain on the device is bigger
+    TEST_ASSERT_TRUE(ringNs < listNs);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_capacity_rounded_to_power_of_two);
+    RUN_TEST(test_fifo_order);
+    RUN_TEST(test_overflow_is_counted);
+    RUN_TEST(test_wraps_around);
+    RUN_TEST(test_clear);
+    RUN_TEST(test_ring_faster_than_list);
+    return UNITY_END();
+}
@@ -0,0 +1,61 @@
+#include <unity.h>
+
+#include "host_stubs.h"
+
+#include "entities/routingTable/RouteNode.h"
+#include "entities/routingTable/NeighborNode.h"
+#include "utilities/HashIndex.hpp"
+#include "utilities/MemoryPool.hpp"
+
+// Bytes reserved by a routing table of a capacity, the same parts as RoutingTableService::getMemory().
+// The index slots hold a pointer, they are 8 bytes on the ESP32 and 16 bytes on a 64 bit host
+static size_t getRoutingTableBytes(size_t capacity) {
+    LM_MemoryPool pool(sizeof(RouteNode), capacity);
+    LM_HashIndex<RouteNode> index(capacity);
+
+    return pool.getBlockSize() * pool.getBlockCount() + index.getMemory() + sizeof(NeighborNode) * LM_MAX_NEIGHBORS;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_memory_per_route() {
+    const size_t capacities[] = {16, 64, 256, 512, 1024};
+    char message[96];
+
+    for (size_t capacity : capacities) {
+        size_t bytes = getRoutingTableBytes(capacity);
+
+        snprintf(message, sizeof(message), "capacity %4u: %6u bytes, %u bytes per route", (unsigned) capacity,
+            (unsigned) bytes, (unsigned) (bytes / capacity));
+        TEST_MESSAGE(message);
+    }
+
+    snprintf(message, sizeof(message), "RouteNode %u bytes, index slot %u bytes, NeighborNode %u bytes",
+        (unsigned) sizeof(RouteNode), (unsigned) (LM_HashIndex<RouteNode>(1).getMemory() / 2), (unsigned) sizeof(NeighborNode));
+    TEST_MESSAGE(message);
+}
+
+void test_route_node_is_packed() {
+    // The pool rounds the blocks up to 8 bytes, the route needs to fill them
+    LM_MemoryPool pool(sizeof(RouteNode), 1);
+    TEST_ASSERT_LESS_THAN(8, pool.getBlockSize() - sizeof(RouteNode));
+}
+
+void test_large_mesh_fits() {
+    // A 500 node mesh with the index slots of up to 1024 routes
+    size_t bytes = getRoutingTableBytes(512);
+    TEST_ASSERT_LESS_OR_EQUAL(64 * 1024, bytes);
+
+    // The neighbors are a fixed cost, the bytes per route go down with the capacity
+    TEST_ASSERT_LESS_THAN(getRoutingTableBytes(16) / 16, bytes / 512);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_memory_per_route);
+    RUN_TEST(test_route_node_is_packed);
+    RUN_TEST(test_large_mesh_fits);
+    return UNITY_END();
+}
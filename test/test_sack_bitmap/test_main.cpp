@@ -0,0 +1,84 @@
+#include <unity.h>
+
+#include "host_stubs.h"
+
+#include "utilities/SackBitmap.hpp"
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_set_and_get() {
+    uint8_t bitmap[2] = {0};
+
+    LM_SackBitmap::Set(bitmap, sizeof(bitmap), 0);
+    LM_SackBitmap::Set(bitmap, sizeof(bitmap), 9);
+
+    TEST_ASSERT_EQUAL_UINT8(0x01, bitmap[0]);
+    TEST_ASSERT_EQUAL_UINT8(0x02, bitmap[1]);
+
+    TEST_ASSERT_TRUE(LM_SackBitmap::Get(bitmap, sizeof(bitmap), 0));
+    TEST_ASSERT_FALSE(LM_SackBitmap::Get(bitmap, sizeof(bitmap), 1));
+    TEST_ASSERT_TRUE(LM_SackBitmap::Get(bitmap, sizeof(bitmap), 9));
+}
+
+void test_bits_outside_are_ignored() {
+    // Only the first 2 bytes are the bitmap, the last one must not be changed
+    uint8_t bitmap[3] = {0};
+
+    LM_SackBitmap::Set(bitmap, 2, 16);
+
+    TEST_ASSERT_FALSE(LM_SackBitmap::Any(bitmap, sizeof(bitmap)));
+    TEST_ASSERT_FALSE(LM_SackBitmap::Get(bitmap, 2, 16));
+}
+
+void test_shift_carries_between_bytes() {
+    uint8_t bitmap[2] = {0x03, 0x01};
+
+    // Bit 8 moves to bit 7 of the first byte, bit 0 is dropped
+    LM_SackBitmap::Shift(bitmap, sizeof(bitmap));
+
+    TEST_ASSERT_EQUAL_UINT8(0x81, bitmap[0]);
+    TEST_ASSERT_EQUAL_UINT8(0x00, bitmap[1]);
+}
+
+void test_any_and_last() {
+    uint8_t bitmap[3] = {0};
+
+    TEST_ASSERT_FALSE(LM_SackBitmap::Any(bitmap, sizeof(bitmap)));
+    TEST_ASSERT_EQUAL_INT(-1, LM_SackBitmap::Last(bitmap, sizeof(bitmap)));
+
+    LM_SackBitmap::Set(bitmap, sizeof(bitmap), 3);
+    LM_SackBitmap::Set(bitmap, sizeof(bitmap), 17);
+
+    TEST_ASSERT_TRUE(LM_SackBitmap::Any(bitmap, sizeof(bitmap)));
+    TEST_ASSERT_EQUAL_INT(17, LM_SackBitmap::Last(bitmap, sizeof(bitmap)));
+}
+
+void test_receive_window() {
+    uint8_t bitmap[1] = {0};
+
+    // lastAck 0, packets 2 and 3 arrive before 1
+    LM_SackBitmap::Set(bitmap, sizeof(bitmap), 1);
+    LM_SackBitmap::Set(bitmap, sizeof(bitmap), 2);
+    TEST_ASSERT_EQUAL_INT(2, LM_SackBitmap::Last(bitmap, sizeof(bitmap)));
+
+    // Packet 1 arrives, lastAck moves to 3 and nothing is left out of order
+    LM_SackBitmap::Set(bitmap, sizeof(bitmap), 0);
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(LM_SackBitmap::Get(bitmap, sizeof(bitmap), 0));
+        LM_SackBitmap::Shift(bitmap, sizeof(bitmap));
+    }
+
+    TEST_ASSERT_FALSE(LM_SackBitmap::Any(bitmap, sizeof(bitmap)));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_set_and_get);
+    RUN_TEST(test_bits_outside_are_ignored);
+    RUN_TEST(test_shift_carries_between_bytes);
+    RUN_TEST(test_any_and_last);
+    RUN_TEST(test_receive_window);
+    return UNITY_END();
+}
@@ -0,0 +1,179 @@
+#include <unity.h>
+
+#include "host_stubs.h"
+
+#include "utilities/TimerHeap.hpp"
+
+struct Timer {
+    size_t timerIndex = SIZE_MAX;
+};
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_pop_expired_in_deadline_order() {
+    LM_TimerHeap<Timer> heap(4);
+    Timer a, b, c;
+
+    heap.Schedule(&a, 300);
+    heap.Schedule(&b, 100);
+    heap.Schedule(&c, 200);
+
+    TEST_ASSERT_EQUAL_PTR(&b, heap.First());
+    TEST_ASSERT_EQUAL_UINT32(100, heap.getFirstDeadline());
+
+    TEST_ASSERT_NULL(heap.PopExpired(99));
+    TEST_ASSERT_EQUAL_PTR(&b, heap.PopExpired(250));
+    TEST_ASSERT_EQUAL_PTR(&c, heap.PopExpired(250));
+    TEST_ASSERT_NULL(heap.PopExpired(250));
+    TEST_ASSERT_EQUAL_PTR(&a, heap.PopExpired(300));
+
+    TEST_ASSERT_TRUE(b.timerIndex == SIZE_MAX);
+    TEST_ASSERT_EQUAL_UINT(0, heap.getLength());
+}
+
+void test_reschedule_moves_the_element() {
+    LM_TimerHeap<Timer> heap(4);
+    Timer a, b;
+
+    heap.Schedule(&a, 100);
+    heap.Schedule(&b, 200);
+
+    // Scheduling it again changes its deadline, it is not added twice
+    heap.Schedule(&a, 300);
+    TEST_ASSERT_EQUAL_UINT(2, heap.getLength());
+    TEST_ASSERT_EQUAL_PTR(&b, heap.First());
+
+    heap.Schedule(&a, 50);
+    TEST_ASSERT_EQUAL_PTR(&a, heap.First());
+}
+
+void test_cancel() {
+    LM_TimerHeap<Timer> heap(4);
+    Timer timers[4];
+
+    for (int i = 0; i < 4; i++)
+        heap.Schedule(&timers[i], 100 * (i + 1));
+
+    TEST_ASSERT_TRUE(heap.Cancel(&timers[0]));
+    TEST_ASSERT_FALSE(heap.Cancel(&timers[0]));
+    TEST_ASSERT_TRUE(timers[0].timerIndex == SIZE_MAX);
+
+    TEST_ASSERT_TRUE(heap.Cancel(&timers[2]));
+    TEST_ASSERT_EQUAL_PTR(&timers[1], heap.PopExpired(1000));
+    TEST_ASSERT_EQUAL_PTR(&timers[3], heap.PopExpired(1000));
+    TEST_ASSERT_NULL(heap.PopExpired(1000));
+}
+
+void test_grows_when_full() {
+    LM_TimerHeap<Timer> heap(1);
+    Timer timers[20];
+
+    for (int i = 0; i < 20; i++)
+        TEST_ASSERT_TRUE(heap.Schedule(&timers[i], 1000 - i));
+
+    TEST_ASSERT_EQUAL_UINT(20, heap.getLength());
+
+    for (int i = 19; i >= 0; i--)
+        TEST_ASSERT_EQUAL_PTR(&timers[i], heap.PopExpired(1000));
+}
+
+void test_deadlines_across_the_wrap_around() {
+    LM_TimerHeap<Timer> heap(4);
+    Timer beforeWrap, afterWrap;
+
+    // A deadline after the overflow of millis() is still later
+    heap.Schedule(&afterWrap, 100);
+    heap.Schedule(&beforeWrap, (unsigned long) -100);
+
+    TEST_ASSERT_EQUAL_PTR(&beforeWrap, heap.First());
+    TEST_ASSERT_NULL(heap.PopExpired((unsigned long) -200));
+    TEST_ASSERT_EQUAL_PTR(&beforeWrap, heap.PopExpired(0));
+    TEST_ASSERT_NULL(heap.PopExpired(0));
+}
+
+void test_clear() {
+    LM_TimerHeap<Timer> heap(4);
+    Timer a, b;
+
+    heap.Schedule(&a, 100);
+    heap.Schedule(&b, 200);
+    heap.Clear();
+
+    TEST_ASSERT_EQUAL_UINT(0, heap.getLength());
+    TEST_ASSERT_TRUE(a.timerIndex == SIZE_MAX);
+    TEST_ASSERT_TRUE(b.timerIndex == SIZE_MAX);
+}
+
+// Timeouts of the reliable transfers, each one is scheduled again when it expires as a retry
+static void simulateTimeouts(bool polling, unsigned long& maxLateness, unsigned long& totalLateness, uint32_t& wakeups) {
+    const size_t sequences = 32;
+    const uint32_t expirations = 1000;
+    LM_TimerHeap<Timer> heap(sequences);
+    Timer timers[sequences];
+    uint32_t seed = 1;
+    unsigned long now = 0;
+
+    auto timeout = [&seed](size_t i) {
+        seed = seed * 1103515245 + 12345;
+        return MIN_TIMEOUT * 1000UL + (i % 4 + 1) * 5000UL + (seed >> 16) % 10000;
+    };
+
+    for (size_t i = 0; i < sequences; i++)
+        heap.Schedule(&timers[i], timeout(i));
+
+    maxLateness = totalLateness = 0;
+    wakeups = 0;
+
+    for (uint32_t expired = 0; expired < expirations;) {
+        // Before the heap the queue manager woke up each MIN_TIMEOUT seconds and checked all the sequences
+        now = polling ? now + MIN_TIMEOUT * 1000UL : heap.getFirstDeadline();
+        wakeups++;
+
+        unsigned long deadline = heap.getFirstDeadline();
+        Timer* timer;
+        while ((timer = heap.PopExpired(now)) != nullptr) {
+            unsigned long lateness = now - deadline;
+            maxLateness = max(maxLateness, lateness);
+            totalLateness += lateness;
+            expired++;
+
+            heap.Schedule(timer, now + timeout(timer - timers));
+            deadline = heap.getFirstDeadline();
+        }
+    }
+
+    totalLateness /= expirations;
+}
+
+void test_timeouts_latency() {
+    unsigned long heapMax, heapMean, pollingMax, pollingMean;
+    uint32_t heapWakeups, pollingWakeups;
+
+    simulateTimeouts(false, heapMax, heapMean, heapWakeups);
+    simulateTimeouts(true, pollingMax, pollingMean, pollingWakeups);
+
+    char message[96];
+    snprintf(message, sizeof(message), "heap: %lu ms mean, %lu ms max late, %u wakeups", heapMean, heapMax, heapWakeups);
+    TEST_MESSAGE(message);
+    snprintf(message, sizeof(message), "polling: %lu ms mean, %lu ms max late, %u wakeups", pollingMean, pollingMax, pollingWakeups);
+    TEST_MESSAGE(message);
+
+    // Waking up at the first deadline handles every timeout on time
+    TEST_ASSERT_EQUAL_UINT32(0, heapMax);
+    TEST_ASSERT_TRUE(pollingMean > 0);
+    TEST_ASSERT_TRUE(pollingMax < MIN_TIMEOUT * 1000UL);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_pop_expired_in_deadline_order);
+    RUN_TEST(test_reschedule_moves_the_element);
+    RUN_TEST(test_cancel);
+    RUN_TEST(test_grows_when_full);
+    RUN_TEST(test_deadlines_across_the_wrap_around);
+    RUN_TEST(test_clear);
+    RUN_TEST(test_timeouts_latency);
+    return UNITY_END();
+}